@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+enum class CHECKSUM_TYPE : uint8_t
+{
+	CRC32=0,	// IEEE 802.3
+	CRC32C,		// Castagnoli
+	CRC16,		// CCITT, initial value 0xFFFF
+	SUM			// 32 bit sum of the words
+};
+
+// CRCs are computed over the little endian bytes of words
+uint32_t crc32(const uint32_t* words, size_t count);
+uint32_t crc32(const std::vector<uint32_t>& words);
+uint32_t crc32c(const uint32_t* words, size_t count);
+uint16_t crc16(const uint32_t* words, size_t count);
+uint32_t computeChecksum(CHECKSUM_TYPE type, const uint32_t* words, size_t count);
+
+CHECKSUM_TYPE toChecksumType(std::string str, std::function<void(std::string)> errorFunc = nullptr);
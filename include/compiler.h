@@ -2,28 +2,104 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <unordered_map>
+#include <memory>
+#include <ostream>
+#include <istream>
+#include <memory_resource>
 
 #include "sourceFileManager.h"
 #include "objectCode.h"
 #include "converter.h"
+#include "macro.h"
+#include "isa.h"
 
 class Compiler
 {
+	// per-build allocations, released in one step by reset
+	std::pmr::monotonic_buffer_resource arena;
+
 public:
 	ObjectCode objectCode;
 
 	Compiler();
 	~Compiler();
 
+	void setLog(std::ostream& log);
+	void setSourceCache(SourceCache* cache);
+	void setPrecompiled(bool precompiled);
+	void setIncludePaths(const std::vector<std::string>& includePaths);
+	void setPipelined(bool pipelined);
+	void setParallel(bool parallel, unsigned int threads = 0);
 	void reset();
+	void addDefine(std::string identifier, std::string value);
+	void clearDefines();
 	bool compileSource(std::string path);
+	bool compileStream(std::string name, std::istream& stream);
+	std::vector<std::pair<std::string, size_t>> getMemoryUsage();
 
 private:
+	// the encoder of the pipeline allocates from the arena of the compiler it belongs to
+	explicit Compiler(std::pmr::memory_resource* resource);
+
 	SourceFileManager sourceFileManager;
+	std::ostream* log;
+	bool pipelined;
+	bool encodeOnly;	// lines are read by another stage of the pipeline
+	bool parallel;
+	unsigned int encodeThreads;	// threads of the parallel encoder, 0 uses every core
+	const std::unordered_map<std::string, uint32_t>* labels;	// labels resolved before encoding
+
+	// current location for diagnostics and references
+	uint32_t fileId;
+	unsigned int lineNumber;
 
 	std::string line;
 	std::vector<std::string> tokens;
 	std::vector<std::pair<std::string, std::string>> defines;
+	std::vector<std::pair<std::string, std::string>> predefines;
+	std::unordered_map<std::string, Macro> macros;
+	std::unique_ptr<Macro> macroDefinition;
+	unsigned int macroNesting;
+	std::unique_ptr<Macro> repeatDefinition;
+	std::vector<std::string> repeatValues;
+	uint32_t repeatCount;
+	unsigned int repeatNesting;
+	unsigned int expansionDepth;
+	unsigned int expansionCount;
+
+	struct Conditional
+	{
+		bool active;	// lines are compiled
+		bool taken;		// one of the branches was active
+		bool hasElse;
+	};
+	std::vector<Conditional> conditionals;
+	size_t conditionalBase;	// conditionals below belong to the lines around the expanded body
+
+	// line passed between the stages of the pipeline
+	struct PipelineLine
+	{
+		uint32_t fileId;
+		unsigned int lineNumber;
+		std::string line;
+		std::vector<std::string> tokens;
+		bool parsed;
+		std::string messages;	// diagnostics of the reading stage
+		bool end;
+	};
+
+	// instruction which gets encoded after all labels are known
+	struct DeferredInstruction
+	{
+		const Instruction* instruction;
+		std::pmr::vector<std::pmr::string> tokens;
+		uint32_t fileId;
+		unsigned int lineNumber;
+		size_t pos;
+		size_t size;
+	};
+	std::pmr::vector<DeferredInstruction> deferredInstructions;
 
 	int errorCount;
 	int warningCount;
@@ -31,6 +107,29 @@ private:
 	void error(std::string message);
 	void warning(std::string message);
 
+	bool compile();
+	void compileLines();
+	void compileLine();
+	void compilePipelined();
+	bool compileConditional();
+	void compileConditional(const std::string& directive, const std::string& operand, bool replace);
+	bool evaluateCondition(std::string condition, bool replace);
+	void closeConditionals(std::string block);
+	bool replaceDefines(std::string& str);
+	void compileTokens();
+	void compileInclude();
+	void compileDefine();
+	void beginMacro();
+	void recordMacro();
+	void expandMacro(Macro& macro);
+	void beginRepeat();
+	void recordRepeat();
+	void expandRepeat(Macro& block, std::vector<std::string>& values, uint32_t count);
+	void deferInstruction(const Instruction& instruction);
+	void encodeDeferredInstructions();
+
+	void addInstruction(const Instruction& instruction);
+
 	void addInst_noOperands(uint8_t opcode, uint8_t func = 0x00);
 	void addInst_dstA_imm(uint8_t opcode, uint8_t func = 0x00, std::function<uint32_t(std::string, std::function<void(std::string)>)> toImmediate = toWord);
 	void addInst_srcB_dstA(uint8_t opcode, uint8_t func = 0x00);
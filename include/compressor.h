@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+
+// run length encoded object code for slow boot loaders
+// the stream starts with the destination address, followed by records up to a zero header
+// a header with bit 31 set repeats the following word (header & 0x7FFFFFFF) times
+// a header with bit 31 clear is followed by that many literal words
+std::vector<uint32_t> compressRle(const std::vector<uint32_t>& words, uint32_t address);
+
+// prepends a decompressor assembled for org, which unpacks the stream and jumps to address
+// words from org on are not unpacked, they have to be zero when org lies inside of the object code
+// like the stream, the boot image starts with its load address org, the words after it are loaded there unchanged
+bool buildBootImage(const std::vector<uint32_t>& words, uint32_t address, uint32_t org, std::vector<uint32_t>& image, std::ostream& log);
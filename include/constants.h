@@ -2,11 +2,12 @@
 #include <iostream>
 
 const uint32_t memorySize = 4096;
+const unsigned int maxExpansionDepth = 256;
 const uint8_t SP = 61;
 const uint8_t SR = 62;
 const uint8_t PC = 63;
 
-extern uint32_t basePtr;
+const uint32_t defaultBasePtr = 0x00001000;
 
 enum class INST : uint8_t
 {
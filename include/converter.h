@@ -13,9 +13,13 @@ bool isFloat(std::string str);
 bool isChar(std::string str);
 bool isString(std::string str);
 bool isRegister(std::string str);
+bool isExpression(std::string str);
 
+int64_t evaluateExpression(std::string str);
 uint32_t toInt(std::string str, std::function<void(std::string)> errorFunc = nullptr);
 uint32_t toFloat(std::string str, std::function<void(std::string)> errorFunc = nullptr);
+uint32_t floatToWord(float val);
+double toReal(std::string str, std::function<void(std::string)> errorFunc = nullptr);
 uint32_t toChar(std::string str, std::function<void(std::string)> errorFunc = nullptr);
 uint32_t toWord(std::string str, std::function<void(std::string)> errorFunc = nullptr);
 std::vector<uint32_t> toString(std::string str, std::function<void(std::string)> errorFunc = nullptr);
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+const uint32_t deltaMagic = 0x544C4441;	// "ADLT"
+
+// range of words which differ between two images
+struct DeltaRange
+{
+	size_t begin;
+	size_t count;
+};
+
+bool readImage(std::string path, std::vector<uint32_t>& words);
+std::vector<DeltaRange> findChangedRanges(const std::vector<uint32_t>& previous, const std::vector<uint32_t>& current);
+
+// patch for the field updater, every word is little endian
+// header: magic, base address, number of ranges, CRC-32 of the complete image
+// every range: address, number of words, CRC-32 of the words, words
+std::vector<uint32_t> buildDelta(const std::vector<uint32_t>& previous, const std::vector<uint32_t>& current, uint32_t address);
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include "mapFile.h"
+#include "isa.h"
+
+// inverts getMachineCode with the instruction set of the compiler, the first row of an encoding is its mnemonic
+// words which the compiler cannot generate are listed as data
+class Disassembler
+{
+public:
+	Disassembler();
+	~Disassembler();
+
+	// symbols have to be set before the image is loaded, the image is decoded while loading
+	void setSymbols(const std::vector<MapSymbol>& symbols);
+	void load(const std::vector<uint32_t>& words, uint32_t address);
+
+	void writeListing(std::string& text) const;
+	void writeTrace(const std::vector<uint32_t>& trace, size_t begin, size_t end, std::string& text) const;
+
+private:
+	std::vector<const Instruction*> instructions;	// first row of every opcode and func
+	std::vector<const Instruction*> comparisons;	// rows without destination, they share their encoding with arithmetic instructions
+	std::vector<uint32_t> words;
+	uint32_t address;
+	std::vector<MapSymbol> symbols;
+	std::vector<std::vector<const MapSymbol*>> labels;	// labels at every word of the image
+	std::vector<std::string> decoded;	// instruction text of every word
+	std::vector<uint8_t> sizes;			// size of the instruction at every word, 0 for data
+
+	size_t decode(size_t pos, std::string& text) const;
+	bool writeOperands(const Instruction& instruction, uint32_t word, uint32_t immediate, std::string& text) const;
+	void writeAddress(uint8_t baseReg, bool fetchImmediate, uint32_t immediate, std::string& text) const;
+	const MapSymbol* findSymbol(uint32_t address) const;
+	bool isLabel(uint32_t address) const;
+};
+
+// listing which assembles to the same object code, or one line per sample of a program counter trace
+void writeDisassembly(const Disassembler& disassembler, const std::vector<uint32_t>* trace, std::ostream& out);
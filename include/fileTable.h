@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <filesystem>
+
+// process wide table of canonical source file paths, every path is resolved once and identified by a compact id
+class FileTable
+{
+public:
+	FileTable();
+	~FileTable();
+
+	uint32_t getId(std::filesystem::path path);
+	const std::string& getPath(uint32_t id);
+
+private:
+	std::mutex mutex;
+	std::deque<std::string> paths;	// references stay valid when paths are added
+	std::unordered_map<std::string, uint32_t> ids;
+};
+
+extern FileTable fileTable;
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "constants.h"
+
+// operand forms, each form is encoded by one of the addInst_ functions of the compiler
+enum class OPERAND_FORM : uint8_t
+{
+	NONE,
+	DSTA_IMM,
+	SRCB_DSTA,
+	SRCB_ADDR,
+	DSTA_ADDR,
+	SRCB,
+	DSTA,
+	SRCA_SRCB_DSTA,
+	SRCA_SRCB_DSTA_DSTB,
+	SRCA_DSTA,
+	SRCA_SRCB_DSTA_RM,
+	SRCA_DSTA_RM,
+	SRCA_SRCB,
+	ADDR
+};
+
+// conversion of immediate operands
+enum class IMMEDIATE_TYPE : uint8_t
+{
+	INT,
+	WORD,
+	FLOAT
+};
+
+struct Instruction
+{
+	std::string mnemonic;	// lower case, upper case is accepted as well
+	INST opcode;
+	uint8_t func;			// default func, including the default rounding mode
+	OPERAND_FORM form;
+	IMMEDIATE_TYPE immediate;
+};
+
+extern const std::vector<Instruction> instructionSet;
+
+const Instruction* findInstruction(const std::string& mnemonic);
+size_t getInstructionSize(const Instruction& instruction, const std::vector<std::string>& tokens);
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <ostream>
+
+#include "objectCode.h"
+
+const uint32_t lineMapMagic = 0x4D4E4C41;	// "ALNM"
+
+// binary line map, every word is little endian
+// header: magic, number of files, number of entries
+// every file: length in bytes, path without terminator
+// every entry, sorted by address: address, file index, line number
+// an entry covers the words up to the address of the next one, gaps of .org and the padding have file index noFileId
+// the text form has one line per entry with the address and file:line, or - for gaps and padding
+void writeLineMap(const ObjectCode& objectCode, bool text, std::ostream& out);
+
+struct LineMapEntry
+{
+	uint32_t address;
+	uint32_t file;
+	uint32_t lineNumber;
+};
+
+// lookup table for tools which map addresses back to source lines
+struct LineMap
+{
+	std::vector<std::string> files;
+	std::vector<LineMapEntry> entries;
+
+	bool read(std::string path);
+	const LineMapEntry* find(uint32_t address) const;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class Macro
+{
+public:
+	Macro(std::string name, std::vector<std::string> params);
+	~Macro();
+
+	std::string getName();
+	size_t getParamCount();
+	size_t getLineCount();
+	bool getParamIndex(std::string param, size_t& index);
+
+	void addLine(std::vector<std::string>& tokens);
+	void expandLine(size_t index, std::vector<std::string>& args, unsigned int id, std::vector<std::string>& tokens);
+
+private:
+	// part of a body token, either literal text or a placeholder for an argument
+	struct TokenPart
+	{
+		std::string text;
+		int param;
+	};
+
+	std::string name;
+	std::vector<std::string> params;
+
+	// body is stored pre-tokenized and flattened: each line ends at lineEnds[i] in tokenEnds,
+	// each token ends at tokenEnds[j] in parts
+	std::vector<TokenPart> parts;
+	std::vector<size_t> tokenEnds;
+	std::vector<size_t> lineEnds;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <ostream>
+
+#include "objectCode.h"
+
+// label with the words up to the next label or the end of its segment
+struct MapSymbol
+{
+	std::string name;
+	uint32_t address;
+	size_t size;
+	uint32_t fileId;
+	unsigned int lineNumber;
+};
+
+// symbols sorted by address, the first definition of a label is used
+std::vector<MapSymbol> collectSymbols(const ObjectCode& objectCode);
+
+// symbols of a map file written by writeMap, for tools which only have the object code
+// the source of a symbol is not resolved, its file id is noFileId
+bool readMap(std::string path, std::vector<MapSymbol>& symbols);
+
+// linker map with segments, symbols by address and by size and the memory usage
+void writeMap(const ObjectCode& objectCode, std::ostream& out);
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+enum class MEMORY_STAGE : uint8_t
+{
+	OTHER=0,
+	READ,
+	DEFINES,
+	TOKENIZE,
+	CONVERT,
+	ENCODE,
+	LINK,
+	EXPORT
+};
+
+// allocations are only counted in builds with MEMORY_REPORT defined, which replace the global operator new and delete
+// the project defines it in all configurations, other builds report the peak RSS and the largest containers only
+#ifdef MEMORY_REPORT
+// attributes all allocations of the current thread to a stage while it exists
+class MemoryStage
+{
+public:
+	MemoryStage(MEMORY_STAGE stage);
+	~MemoryStage();
+
+private:
+	MEMORY_STAGE previous;
+};
+#else
+class MemoryStage
+{
+public:
+	MemoryStage(MEMORY_STAGE) {}
+};
+#endif
+
+void enableMemoryReport();
+size_t getPeakRss();
+void printMemoryReport(std::ostream& log, std::vector<std::pair<std::string, size_t>> containers);
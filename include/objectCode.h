@@ -1,44 +1,110 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <ostream>
+#include <unordered_map>
+#include <memory_resource>
+
+#include "objectWriter.h"
+#include "checksum.h"
 
 struct Reference
 {
-	std::string identifier;
+	std::pmr::string identifier;
 	size_t pos;
-	std::string sourceFile;
+	uint32_t fileId;
 	unsigned int lineNumber;
 };
 
 struct Dereference
 {
-	std::string identifier;
+	std::pmr::string identifier;
 	uint32_t address;
+	uint32_t fileId;
+	unsigned int lineNumber;
+};
+
+// words from begin up to end were generated after a .org directive
+struct Segment
+{
+	size_t begin;
+	size_t end;
+};
+
+const uint32_t noFileId = 0xFFFFFFFF;	// words which belong to no source line
+
+// source line of the words from pos up to the pos of the next entry
+struct LineEntry
+{
+	size_t pos;
+	uint32_t fileId;
+	unsigned int lineNumber;
+};
+
+// slot which receives the checksum over [start, end) after linking
+struct Checksum
+{
+	CHECKSUM_TYPE type;
+	std::pmr::string start;
+	std::pmr::string end;
+	size_t pos;
+	uint32_t fileId;
+	unsigned int lineNumber;
 };
 
 class ObjectCode
 {
 public:
-	ObjectCode();
+	ObjectCode(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	ObjectCode(ObjectCode&& other) = default;
 	~ObjectCode();
 
+	// symbols only change owner if both use the same memory resource, otherwise they get copied
+	ObjectCode& operator=(ObjectCode&& other) = default;
+
 	void append(uint32_t code);
-	void append(std::vector<uint32_t> code);
-	size_t size();
+	void append(const std::vector<uint32_t>& code);
+	size_t size() const;
 	void resize(size_t n, const uint32_t& value);
+	void org(size_t pos);
+	void endSegment();
+	const std::pmr::vector<Segment>& getSegments() const;
 	void clear();
 	bool empty();
+	void setBasePtr(uint32_t address);
+	uint32_t getBasePtr() const;
+	const std::vector<uint32_t>& getData() const;
+	void write(size_t pos, ObjectCode& code);
+
+	void setWriter(ObjectWriter* writer);
+	bool isStreaming() const;
+	void reserveImage();	// only for the image of a build, object code of single instructions grows as needed
+	void flush();
 
-	void addReference(std::string identifier, std::string sourceFile, unsigned int lineNumber);
-	void addDereference(std::string identifier);
-	void link(int& errorCount);
+	void addReference(std::string identifier, uint32_t fileId, unsigned int lineNumber);
+	void addDereference(std::string identifier, uint32_t fileId, unsigned int lineNumber);
+	const std::pmr::vector<Dereference>& getDereferences() const;
+	void addLine(uint32_t fileId, unsigned int lineNumber);
+	const std::pmr::vector<LineEntry>& getLines() const;	// complete unless the object code is streamed
+	void addChecksum(CHECKSUM_TYPE type, std::string start, std::string end, uint32_t fileId, unsigned int lineNumber);
+	std::vector<std::pair<std::string, size_t>> getMemoryUsage();
+	std::unordered_map<std::string, uint32_t> getLabels();
+	void link(int& errorCount, std::ostream& log);
+	void applyChecksums(int& errorCount, std::ostream& log);
 
 	bool exportRaw(std::string path);
 	bool exportMif(std::string path);
 	bool exportCoe(std::string path);
+	bool exportTo(ObjectWriter& writer, std::string path) const;
 
 private:
 	std::vector<uint32_t> data;
-	std::vector<Reference> references;
-	std::vector<Dereference> dereferences;
+	ObjectWriter* writer;	// streams finished words instead of keeping them
+	size_t flushed;			// number of words already passed to the writer
+	uint32_t basePtr;
+	std::pmr::vector<Reference> references;
+	std::pmr::vector<Dereference> dereferences;
+	std::pmr::vector<Checksum> checksums;
+	std::pmr::vector<LineEntry> lines;
+	std::pmr::vector<Segment> segments;
 };
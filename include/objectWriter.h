@@ -0,0 +1,141 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <cstdint>
+
+// writes object code to a file block by block, words which are already written can be patched
+// the file is written to <path>.tmp and only replaces the destination when it is complete
+// other streams, like standard output, get the object code in one piece when it is complete
+class ObjectWriter
+{
+public:
+	ObjectWriter();
+	virtual ~ObjectWriter();
+
+	void setLog(std::ostream& log);
+	void setWriteIfChanged(bool writeIfChanged);
+	bool open(std::string path);
+	bool open(std::ostream& target);
+	virtual void write(const std::vector<uint32_t>& words);
+	void patch(size_t pos, uint32_t word);
+	bool close(bool keep);
+
+protected:
+	std::ostream* out;	// file or buffer the formats write to
+
+	virtual std::string getExtension() = 0;
+	virtual bool isBinary();
+	virtual void writeHeader();
+	virtual void writeLine(size_t pos, uint32_t word);
+	virtual void writeWord(uint32_t word) = 0;
+	virtual std::streamoff getWordOffset();
+	virtual void writeFooter(size_t count);
+
+	void seekWord(size_t pos);
+	void writeHex(uint32_t value, unsigned int digits);
+	void fail();
+	bool hasFailed();
+
+private:
+	std::ostream* log;
+	std::ofstream file;
+	std::stringstream buffer;
+	std::ostream* target;
+	bool writeIfChanged;	// identical files are not replaced, so their modification time is kept
+	std::filesystem::path path;
+	std::filesystem::path tempPath;
+	std::streamoff dataBegin;
+	std::streamoff lineSize;	// every word is written to a line of the same size
+	size_t count;
+	bool failed;
+
+	bool begin();
+};
+
+class RawWriter : public ObjectWriter
+{
+protected:
+	std::string getExtension() override;
+	bool isBinary() override;
+	void writeWord(uint32_t word) override;
+};
+
+class MifWriter : public ObjectWriter
+{
+public:
+	MifWriter();
+
+protected:
+	std::string getExtension() override;
+	void writeHeader() override;
+	void writeLine(size_t pos, uint32_t word) override;
+	void writeWord(uint32_t word) override;
+	std::streamoff getWordOffset() override;
+	void writeFooter(size_t count) override;
+
+private:
+	unsigned int fill;	// digits of the address
+};
+
+class CoeWriter : public ObjectWriter
+{
+protected:
+	std::string getExtension() override;
+	void writeHeader() override;
+	void writeLine(size_t pos, uint32_t word) override;
+	void writeWord(uint32_t word) override;
+	void writeFooter(size_t count) override;
+};
+
+// run length encoded stream, binary like raw object code
+class RleWriter : public RawWriter
+{
+protected:
+	std::string getExtension() override;
+};
+
+// changed ranges against a previous image, binary like raw object code
+class DeltaWriter : public RawWriter
+{
+protected:
+	std::string getExtension() override;
+};
+
+// $readmemh / updatemem format, zero words are skipped by @address records
+// a writer can be limited to a slice of bits and a range of addresses, which is one block ram primitive
+// it can not be streamed, because records have no fixed size
+class MemWriter : public ObjectWriter
+{
+public:
+	MemWriter(unsigned int width = 32, unsigned int shift = 0, size_t begin = 0, size_t depth = SIZE_MAX);
+
+	void write(const std::vector<uint32_t>& words) override;
+
+protected:
+	std::string getExtension() override;
+	void writeLine(size_t pos, uint32_t word) override;
+	void writeWord(uint32_t word) override;
+
+private:
+	unsigned int width;
+	unsigned int shift;
+	size_t begin;
+	size_t depth;
+	size_t pos;		// position of the next word
+	size_t next;	// address which follows the last written word
+	unsigned int fill;
+};
+
+std::unique_ptr<ObjectWriter> createObjectWriter(std::string option);
+
+void writeHex(std::ostream& out, uint32_t value, unsigned int digits);
+
+// reports which are no object code follow the same rules: <path><extension>.tmp replaces the destination when write returns,
+// "-" is standard output, and with writeIfChanged identical files are kept
+// write may throw std::ios::failure, the stream is set up to throw on errors
+bool writeReport(std::string path, std::string extension, bool binary, bool writeIfChanged, std::ostream& log, std::function<void(std::ostream&)> write);
@@ -7,3 +7,4 @@ bool parseAddress(std::string address, std::string& baseReg, std::string& offset
 bool contains(std::string str, const char c);
 bool endsWith(std::string str, std::string end);
 size_t find_first_of_outside_str(std::string str, std::string charsToFind);
+size_t find_first_of_outside_parentheses(std::string str, std::string charsToFind);
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <functional>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "sourceFile.h"
+
+// loads source files on a pool of reader threads before they are needed
+class Prefetcher
+{
+public:
+	Prefetcher(std::function<std::shared_ptr<const SourceBuffer>(uint32_t)> loadFunc);
+	~Prefetcher();
+
+	void prefetch(uint32_t fileId);
+	std::shared_ptr<const SourceBuffer> take(uint32_t fileId);
+	void clear();
+
+private:
+	std::function<std::shared_ptr<const SourceBuffer>(uint32_t)> loadFunc;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::packaged_task<std::shared_ptr<const SourceBuffer>()>> tasks;
+	std::unordered_map<uint32_t, std::shared_future<std::shared_ptr<const SourceBuffer>>> buffers;
+	bool stop;
+
+	void work();
+};
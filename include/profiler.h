@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include "objectCode.h"
+#include "mapFile.h"
+
+// samples of a program counter trace, which holds the address of every executed instruction as little endian word
+// call stacks are reconstructed from the instructions of the object code the samples point to
+struct Profile
+{
+	std::vector<MapSymbol> symbols;
+	std::vector<uint64_t> counts;	// samples per word of the object code
+	uint64_t total = 0;
+	uint64_t outside = 0;			// samples outside of the object code
+	std::vector<std::pair<std::string, uint64_t>> stacks;	// folded call stacks, sorted by name
+
+	void build(const ObjectCode& objectCode, const std::vector<uint32_t>& trace);
+};
+
+enum class PROFILE_OUTPUT : uint8_t
+{
+	REPORT,
+	ANNOTATED,
+	FOLDED
+};
+
+// samples per routine and per line, source lines prefixed by their samples, or folded stacks for flame graphs
+void writeProfile(const ObjectCode& objectCode, const Profile& profile, PROFILE_OUTPUT output, std::ostream& out);
+std::string getProfileExtension(PROFILE_OUTPUT output);
@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// bounded lock-free queue for exactly one producer and one consumer thread
+// a thread only takes the lock to sleep while the buffer is full or empty and to wake the other one
+template<typename T>
+class RingBuffer
+{
+public:
+	RingBuffer(size_t capacity) : slots(capacity + 1), head{ 0 }, tail{ 0 }, producerWaiting{ false }, consumerWaiting{ false }
+	{
+
+	}
+
+	// blocks while the buffer is full
+	void push(T&& item)
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		size_t next = (pos + 1) % slots.size();
+
+		if (next == head.load(std::memory_order_acquire))
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			producerWaiting = true;
+			changed.wait(lock, [&]() { return next != head.load(); });
+			producerWaiting = false;
+		}
+
+		slots[pos] = std::move(item);
+		tail.store(next);
+
+		if (consumerWaiting.load())
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			changed.notify_all();
+		}
+	}
+
+	// blocks while the buffer is empty
+	T pop()
+	{
+		size_t pos = head.load(std::memory_order_relaxed);
+
+		if (pos == tail.load(std::memory_order_acquire))
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			consumerWaiting = true;
+			changed.wait(lock, [&]() { return pos != tail.load(); });
+			consumerWaiting = false;
+		}
+
+		T item = std::move(slots[pos]);
+		head.store((pos + 1) % slots.size());
+
+		if (producerWaiting.load())
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			changed.notify_all();
+		}
+
+		return item;
+	}
+
+private:
+	std::vector<T> slots;
+	alignas(64) std::atomic<size_t> head;	// next slot to read, written by consumer
+	alignas(64) std::atomic<size_t> tail;	// next slot to write, written by producer
+
+	// the waiting flags and the positions are sequentially consistent, so a thread going to sleep either sees the new position or gets woken
+	std::atomic<bool> producerWaiting;
+	std::atomic<bool> consumerWaiting;
+	std::mutex mutex;
+	std::condition_variable changed;
+};
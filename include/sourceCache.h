@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <filesystem>
+
+#include "sourceFile.h"
+
+// thread safe cache of lexed source files, which can be shared by several compilers
+class SourceCache
+{
+public:
+	SourceCache();
+	~SourceCache();
+
+	void setPrecompiled(bool precompiled);
+	std::shared_ptr<const SourceBuffer> getBuffer(uint32_t fileId);
+	void addMissing(uint32_t fileId);
+	bool refresh();
+	void clear();
+
+private:
+	// files which could not be read have no buffer, they count as changed once they exist
+	struct Entry
+	{
+		std::shared_ptr<const SourceBuffer> buffer;
+		std::filesystem::file_time_type lastWriteTime;
+	};
+
+	std::mutex mutex;
+	bool precompiled;
+	std::unordered_map<uint32_t, Entry> entries;
+};
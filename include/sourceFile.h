@@ -1,20 +1,40 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <memory>
 #include <fstream>
 #include <filesystem>
 
+// content of a source file, optionally with the tokens of every line
+struct SourceBuffer
+{
+	std::vector<std::string> lines;
+	std::vector<std::vector<std::string>> tokens;
+
+	void load(std::filesystem::path path, bool lex);
+	void load(std::istream& stream);
+	void loadPrecompiled(std::filesystem::path path);
+
+private:
+	void split(std::string& content);
+	void lex();
+	bool readPrecompiled(std::ifstream& file, uint64_t size);
+	void writePrecompiled(std::filesystem::path path, int64_t lastWriteTime, uint64_t size, uint64_t hash);
+};
+
 class SourceFile
 {
 public:
-	SourceFile(std::filesystem::path path);
+	SourceFile(uint32_t fileId, std::shared_ptr<const SourceBuffer> buffer = nullptr);
 	~SourceFile();
 
-	std::string getPath();
+	uint32_t getFileId();
 	bool getLine(std::string& line);
+	const std::vector<std::string>* getTokens();
 	unsigned int getLineNumber();
 
 private:
-	std::filesystem::path path;
-	std::ifstream file;
+	uint32_t fileId;
+	std::shared_ptr<const SourceBuffer> buffer;
 	unsigned int lineNumber;
 };
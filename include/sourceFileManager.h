@@ -1,9 +1,13 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <filesystem>
 
 #include "sourceFile.h"
+#include "sourceCache.h"
+#include "prefetcher.h"
 
 class SourceFileManager
 {
@@ -11,14 +15,29 @@ public:
 	SourceFileManager();
 	~SourceFileManager();
 
+	void setCache(SourceCache* cache);
+	void setPrecompiled(bool precompiled);
+	void setIncludePaths(const std::vector<std::string>& includePaths);
 	bool addFile(std::string path);
+	bool addStream(std::string name, std::istream& stream);
 	void closeAll();
-	std::string getPath();
+	const std::string& getPath();
+	uint32_t getFileId();
 	bool getLine(std::string& line);
+	const std::vector<std::string>* getTokens();
 	unsigned int getLineNumber();
 
 private:
-	std::vector<SourceFile*> sourceFileStack;
-	std::vector<std::filesystem::path> included_fs_paths;
+	std::vector<SourceFile> sourceFileStack;
+	std::unordered_set<uint32_t> includedFiles;
+	std::unordered_map<std::string, uint32_t> resolvedPaths;	// include path as written -> file id
 	std::filesystem::path basePath;
+	std::vector<std::filesystem::path> includePaths;
+	SourceCache* cache;
+	bool precompiled;
+	Prefetcher prefetcher;	// must be destroyed first, its threads use the members above
+
+	uint32_t resolvePath(std::string path);
+	std::shared_ptr<const SourceBuffer> loadBuffer(uint32_t fileId);
+	void prefetchIncludes(const SourceBuffer& buffer);
 };
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+
+enum class TABLE_FUNC : uint8_t
+{
+	SIN=0,	COS,	TAN,	SQRT,
+	RECIP,	EXP2,	LOG2,	POLY
+};
+
+TABLE_FUNC toTableFunction(std::string str, std::function<void(std::string)> errorFunc = nullptr);
+
+std::vector<uint32_t> generateTable(TABLE_FUNC func, uint32_t n, double scale, bool fixed, std::vector<double> coefficients, std::function<void(std::string)> errorFunc = nullptr);
+std::vector<uint32_t> generateCrcTable(uint32_t poly, unsigned int width, bool reflected);
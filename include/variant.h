@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "objectCode.h"
+
+struct Variant
+{
+	std::string dstPath;
+	std::vector<std::pair<std::string, std::string>> defines;
+};
+
+bool parseDefine(std::string define, std::pair<std::string, std::string>& identifierValue);
+bool readVariants(std::string path, std::vector<Variant>& variants);
+bool compileVariants(std::string srcPath, std::vector<std::pair<std::string, std::string>>& commonDefines,
+	std::vector<Variant>& variants, bool precompiled, bool pipelined, bool parallel, unsigned int encodeThreads, const std::vector<std::string>& includePaths, std::function<bool(ObjectCode&, std::string, std::ostream&)> exportFunc);
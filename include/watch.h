@@ -0,0 +1,7 @@
+#pragma once
+#include <functional>
+
+#include "sourceCache.h"
+
+// rebuilds whenever a source file changes until interrupted or q is entered, returns the result of the last build
+bool watch(SourceCache& cache, std::function<bool()> build);
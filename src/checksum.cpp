@@ -0,0 +1,188 @@
+#include "checksum.h"
+
+#include <array>
+
+// the crc32 instruction of SSE4.2 is selected at run time, builds do not have to target SSE4.2
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CHECKSUM_SSE42
+#define TARGET_SSE42
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CHECKSUM_SSE42
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+typedef std::array<std::array<uint32_t, 256>, 8> SlicingTable;
+
+// table k advances the CRC of a byte by k more zero bytes, so eight bytes are processed per step
+static SlicingTable makeSlicingTable(uint32_t polynomial)
+{
+	SlicingTable table;
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+
+		for (int bit = 0; bit < 8; bit++)
+			crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+
+		table[0][i] = crc;
+	}
+
+	for (size_t k = 1; k < table.size(); k++)
+	{
+		for (uint32_t i = 0; i < 256; i++)
+			table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+	}
+
+	return table;
+}
+
+static const SlicingTable crc32Table = makeSlicingTable(0xEDB88320);
+static const SlicingTable crc32cTable = makeSlicingTable(0x82F63B78);
+
+static const std::array<uint16_t, 256> crc16Table = []()
+{
+	std::array<uint16_t, 256> table;
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint16_t crc = static_cast<uint16_t>(i << 8);
+
+		for (int bit = 0; bit < 8; bit++)
+			crc = crc & 0x8000 ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+
+		table[i] = crc;
+	}
+
+	return table;
+}();
+
+static uint32_t sliceBy8(const SlicingTable& table, const uint32_t* words, size_t count)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	size_t i = 0;
+
+	for (; i + 2 <= count; i += 2)
+	{
+		uint32_t low = crc ^ words[i];
+		uint32_t high = words[i + 1];
+
+		crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+			table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+	}
+
+	for (; i < count; i++)
+	{
+		for (int byte = 0; byte < 4; byte++)
+			crc = (crc >> 8) ^ table[0][(crc ^ (words[i] >> (byte * 8))) & 0xFF];
+	}
+
+	return ~crc;
+}
+
+#ifdef CHECKSUM_SSE42
+static bool hasSse42()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static const bool useSse42 = hasSse42();
+
+// the crc32 instruction implements the Castagnoli polynomial only
+TARGET_SSE42 static uint32_t crc32cSse42(const uint32_t* words, size_t count)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < count; i++)
+		crc = _mm_crc32_u32(crc, words[i]);
+
+	return ~crc;
+}
+#endif
+
+uint32_t crc32(const uint32_t* words, size_t count)
+{
+	return sliceBy8(crc32Table, words, count);
+}
+
+uint32_t crc32(const std::vector<uint32_t>& words)
+{
+	return crc32(words.data(), words.size());
+}
+
+uint32_t crc32c(const uint32_t* words, size_t count)
+{
+#ifdef CHECKSUM_SSE42
+	if (useSse42)
+		return crc32cSse42(words, count);
+#endif
+
+	return sliceBy8(crc32cTable, words, count);
+}
+
+uint16_t crc16(const uint32_t* words, size_t count)
+{
+	uint16_t crc = 0xFFFF;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int byte = 0; byte < 4; byte++)
+			crc = static_cast<uint16_t>((crc << 8) ^ crc16Table[((crc >> 8) ^ (words[i] >> (byte * 8))) & 0xFF]);
+	}
+
+	return crc;
+}
+
+uint32_t computeChecksum(CHECKSUM_TYPE type, const uint32_t* words, size_t count)
+{
+	switch (type)
+	{
+	case CHECKSUM_TYPE::CRC32:
+		return crc32(words, count);
+
+	case CHECKSUM_TYPE::CRC32C:
+		return crc32c(words, count);
+
+	case CHECKSUM_TYPE::CRC16:
+		return crc16(words, count);
+
+	case CHECKSUM_TYPE::SUM:
+		break;
+	}
+
+	uint32_t sum = 0;
+
+	for (size_t i = 0; i < count; i++)
+		sum += words[i];
+
+	return sum;
+}
+
+CHECKSUM_TYPE toChecksumType(std::string str, std::function<void(std::string)> errorFunc)
+{
+	if (str == "crc32" || str == "CRC32")
+		return CHECKSUM_TYPE::CRC32;
+
+	if (str == "crc32c" || str == "CRC32C")
+		return CHECKSUM_TYPE::CRC32C;
+
+	if (str == "crc16" || str == "CRC16")
+		return CHECKSUM_TYPE::CRC16;
+
+	if (str == "sum" || str == "SUM")
+		return CHECKSUM_TYPE::SUM;
+
+	if (errorFunc)
+		errorFunc("unknown checksum '" + str + "'.");
+
+	return CHECKSUM_TYPE::CRC32;
+}
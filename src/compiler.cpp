@@ -1,11 +1,64 @@
 #include "compiler.h"
 #include "constants.h"
 #include "parser.h"
+#include "tableGenerator.h"
+#include "fileTable.h"
+#include "ringBuffer.h"
+#include "memoryReport.h"
+#include "mapFile.h"
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include <utility>
 
-Compiler::Compiler() : errorCount{ 0 }, warningCount{ 0 }
+// lines are passed between the stages of the pipeline in batches
+const size_t pipelineBatchSize = 256;
+const size_t pipelineQueueSize = 16;
+
+// first block of the arena, it grows when a build needs more
+const size_t arenaInitialSize = 64 * 1024;
+
+// deferred instructions are encoded in chunks of this many, the threads take turns on the chunks
+const size_t encodeChunkSize = 256;
+
+// symbols listed when the object code does not fit into memory
+const size_t largestSymbolCount = 5;
+
+// returns the first word of a line if it is a directive
+static std::string getDirective(const std::string& line)
+{
+	size_t begin = line.find_first_not_of(" \t");
+	if (begin == std::string::npos || line.at(begin) != '.')
+		return "";
+
+	size_t end = line.find_first_of(" \t;", begin);
+	if (end == std::string::npos)
+		end = line.size();
+
+	return line.substr(begin, end - begin);
+}
+
+static bool isConditional(const std::string& directive)
+{
+	return directive == ".if" || directive == ".IF" || directive == ".ifdef" || directive == ".IFDEF" ||
+		directive == ".ifndef" || directive == ".IFNDEF" || directive == ".elif" || directive == ".ELIF" ||
+		directive == ".else" || directive == ".ELSE" || directive == ".endif" || directive == ".ENDIF";
+}
+
+// conditionals which test the defines instead of evaluating an expression
+static bool isDefineCondition(const std::string& directive)
+{
+	return directive == ".ifdef" || directive == ".IFDEF" || directive == ".ifndef" || directive == ".IFNDEF";
+}
+
+Compiler::Compiler() : Compiler(&arena)
+{
+
+}
+
+Compiler::Compiler(std::pmr::memory_resource* resource) : arena{ arenaInitialSize }, objectCode{ resource }, log{ &std::cout }, pipelined{ false }, encodeOnly{ false }, parallel{ false }, encodeThreads{ 0 }, labels{ nullptr }, fileId{ 0 }, lineNumber{ 0 }, macroNesting{ 0 }, repeatCount{ 0 }, repeatNesting{ 0 }, expansionDepth{ 0 }, expansionCount{ 0 }, conditionalBase{ 0 }, deferredInstructions{ resource }, errorCount{ 0 }, warningCount{ 0 }
 {
 
 }
@@ -15,6 +68,37 @@ Compiler::~Compiler()
 	reset();
 }
 
+void Compiler::setLog(std::ostream& log)
+{
+	this->log = &log;
+}
+
+void Compiler::setSourceCache(SourceCache* cache)
+{
+	sourceFileManager.setCache(cache);
+}
+
+void Compiler::setPrecompiled(bool precompiled)
+{
+	sourceFileManager.setPrecompiled(precompiled);
+}
+
+void Compiler::setIncludePaths(const std::vector<std::string>& includePaths)
+{
+	sourceFileManager.setIncludePaths(includePaths);
+}
+
+void Compiler::setPipelined(bool pipelined)
+{
+	this->pipelined = pipelined;
+}
+
+void Compiler::setParallel(bool parallel, unsigned int threads)
+{
+	this->parallel = parallel;
+	encodeThreads = threads;
+}
+
 void Compiler::reset()
 {
 	sourceFileManager.closeAll();
@@ -22,355 +106,1069 @@ void Compiler::reset()
 	line.clear();
 	tokens.clear();
 	defines.clear();
+	macros.clear();
+	macroDefinition.reset();
+	macroNesting = 0;
+	repeatDefinition.reset();
+	repeatValues.clear();
+	repeatCount = 0;
+	repeatNesting = 0;
+	expansionDepth = 0;
+	expansionCount = 0;
+	conditionals.clear();
+	conditionalBase = 0;
+	deferredInstructions = std::pmr::vector<DeferredInstruction>(deferredInstructions.get_allocator());
 	errorCount = 0;
 	warningCount = 0;
+
+	// nothing may hold memory of the arena anymore
+	arena.release();
+}
+
+void Compiler::addDefine(std::string identifier, std::string value)
+{
+	// predefines are kept across compilations and get copied into defines when compilation starts
+	predefines.push_back(std::make_pair(identifier, value));
+}
+
+void Compiler::clearDefines()
+{
+	predefines.clear();
 }
 
 bool Compiler::compileSource(std::string path)
 {
 	reset();
+	defines = predefines;
 
 	// try to open source file
 	if (!sourceFileManager.addFile(path))
 	{
-		std::cout << "Fatal: cannot open source file '" << path << "'!" << std::endl;
+		*log << "Fatal: cannot open source file '" << path << "'!" << std::endl;
 		sourceFileManager.closeAll();
 		return false;
 	}
 
+	return compile();
+}
+
+bool Compiler::compileStream(std::string name, std::istream& stream)
+{
+	reset();
+	defines = predefines;
+
+	if (!sourceFileManager.addStream(name, stream))
+	{
+		*log << "Fatal: cannot read source '" << name << "'!" << std::endl;
+		sourceFileManager.closeAll();
+		return false;
+	}
+
+	return compile();
+}
+
+bool Compiler::compile()
+{
+	if (pipelined)
+		compilePipelined();
+	else
+	{
+		objectCode.reserveImage();
+		compileLines();
+	}
+
+	if (macroDefinition)
+	{
+		*log << "macro '" << macroDefinition->getName() << "' is missing .endm directive." << std::endl;
+		errorCount++;
+	}
+	if (repeatDefinition)
+	{
+		*log << "repeat block is missing .endr directive." << std::endl;
+		errorCount++;
+	}
+	if (!conditionals.empty())
+	{
+		*log << conditionals.size() << " conditional block(s) missing .endif directive." << std::endl;
+		errorCount++;
+	}
+
+	encodeDeferredInstructions();
+	objectCode.link(errorCount, *log);
+
+	// padding belongs to no source line and no segment
+	objectCode.addLine(noFileId, 0);
+	objectCode.endSegment();
+	
+	if (objectCode.size() > memorySize)
+	{
+		*log << "object code exceeds memory size by " << objectCode.size() - memorySize << " words." << std::endl;
+		errorCount++;
+
+		// the largest symbols are the first candidates to shrink
+		std::vector<MapSymbol> symbols = collectSymbols(objectCode);
+		size_t count = std::min<size_t>(symbols.size(), largestSymbolCount);
+		std::partial_sort(symbols.begin(), symbols.begin() + count, symbols.end(), [](const MapSymbol& a, const MapSymbol& b) { return a.size > b.size; });
+
+		for (size_t i = 0; i < count; i++)
+			*log << "  " << symbols.at(i).name << ": " << symbols.at(i).size << " words" << std::endl;
+	}
+	else if (objectCode.size() < memorySize)
+		objectCode.resize(memorySize, 0);
+
+	objectCode.applyChecksums(errorCount, *log);
+
+	// remaining words of streamed object code
+	objectCode.flush();
+
+	sourceFileManager.closeAll();
+
+	if (errorCount == 0)
+	{
+		*log << "Compilation succeeded with " << warningCount << " warning(s)!" << std::endl;
+		return true;
+	}
+	else
+	{
+		*log << "Compilation failed with " << errorCount << " error(s) and " << warningCount << " warning(s)!" << std::endl;
+		objectCode.clear();
+		return false;
+	}
+}
+
+void Compiler::compileLines()
+{
 	// iterate over every line in all source files
 	while (sourceFileManager.getLine(line))
 	{
-		// replace defines
-		for (std::pair<std::string, std::string>& define : defines)
+		fileId = sourceFileManager.getFileId();
+		lineNumber = sourceFileManager.getLineNumber();
+		compileLine();
+	}
+}
+
+void Compiler::compileLine()
+{
+	// conditionals of macro bodies and repeat blocks are recorded and evaluated when the body is expanded
+	bool recording = macroDefinition || repeatDefinition;
+
+	// conditional directives are handled before defines get replaced
+	if (!recording && compileConditional())
+		return;
+
+	// skip inactive regions
+	if (!conditionals.empty() && !conditionals.back().active)
+		return;
+
+	// lines without defines can use the tokens of the source cache
+	const std::vector<std::string>* cachedTokens;
+
+	// a recorded .ifdef looks up its define when the body is expanded
+	if (recording && isDefineCondition(getDirective(line)))
+		parseLine(line, tokens);
+
+	else if (!replaceDefines(line) && (cachedTokens = sourceFileManager.getTokens()))
+		tokens = *cachedTokens;
+
+	// parse tokens from line
+	else
+		parseLine(line, tokens);
+
+	compileTokens();
+}
+
+void Compiler::compilePipelined()
+{
+	// stage 1 (this thread) reads lines, handles includes, defines and conditionals
+	// stage 2 parses lines into tokens
+	// stage 3 compiles tokens into object code
+	RingBuffer<std::vector<PipelineLine>> readQueue{ pipelineQueueSize };
+	RingBuffer<std::vector<PipelineLine>> parseQueue{ pipelineQueueSize };
+
+	// the object code of stage 3 is built in the arena of this compiler, so it can be moved without copying
+	// stage 1 must not allocate from the arena while stage 3 runs, it only handles includes, defines and conditionals
+	Compiler encoder{ &arena };
+	encoder.log = log;
+	encoder.encodeOnly = true;
+	encoder.parallel = parallel;
+	encoder.encodeThreads = encodeThreads;
+	encoder.objectCode.reserveImage();
+
+	std::thread parser([&]()
+	{
+		bool end = false;
+
+		while (!end)
 		{
-			size_t pos = line.find(define.first);
+			std::vector<PipelineLine> batch = readQueue.pop();
 
-			while (pos != std::string::npos)
+			for (PipelineLine& item : batch)
 			{
-				line.replace(pos, define.first.length(), define.second);
-				pos = line.find(define.first, pos + define.second.length());
+				end = item.end;
+
+				if (!end && !item.parsed)
+					parseLine(item.line, item.tokens);
 			}
+
+			parseQueue.push(std::move(batch));
 		}
+	});
 
-		// parse tokens from line
-		parseLine(line, tokens);
+	std::thread assembler([&]()
+	{
+		while (true)
+		{
+			std::vector<PipelineLine> batch = parseQueue.pop();
 
-		// skip empty lines
-		if (tokens.empty())
+			for (PipelineLine& item : batch)
+			{
+				// diagnostics of stage 1 are printed in source order
+				*encoder.log << item.messages;
+
+				if (item.end)
+					return;
+
+				encoder.fileId = item.fileId;
+				encoder.lineNumber = item.lineNumber;
+				encoder.tokens = std::move(item.tokens);
+				encoder.compileTokens();
+			}
+		}
+	});
+
+	// diagnostics of this stage are passed along with the next line
+	std::ostringstream messages;
+	std::ostream* output = log;
+	log = &messages;
+
+	// lines of macro bodies and repeat blocks are recorded by stage 3
+	unsigned int bodyNesting = 0;
+	bool sequential = false;
+	std::vector<PipelineLine> batch;
+	batch.reserve(pipelineBatchSize);
+
+	while (sourceFileManager.getLine(line))
+	{
+		fileId = sourceFileManager.getFileId();
+		lineNumber = sourceFileManager.getLineNumber();
+
+		// a define test of a body looks up its define when stage 3 expands the body, but this stage has read ahead by then
+		// the pipeline is drained and the rest of the source is compiled without it, the line is recorded without replacing defines
+		if (bodyNesting > 0 && isDefineCondition(getDirective(line)))
+		{
+			parseLine(line, tokens);
+			sequential = true;
+			break;
+		}
+
+		// conditionals of bodies are recorded by stage 3 like every other line of the body
+		if (bodyNesting == 0 && compileConditional())
 			continue;
 
-		// label
-		if (tokens.at(0).back() == ':')
+		if (!conditionals.empty() && !conditionals.back().active)
+			continue;
+
+		PipelineLine item{};
+		item.fileId = fileId;
+		item.lineNumber = lineNumber;
+		const std::vector<std::string>* cachedTokens;
+
+		// lines which may hold a directive are parsed here, stage 3 sees the same tokens
+		if (!replaceDefines(line) && (cachedTokens = sourceFileManager.getTokens()))
 		{
-			tokens.at(0).pop_back();
-			objectCode.addDereference(tokens.at(0));
-			tokens.erase(tokens.begin());
-			if (tokens.empty())
-				continue;
+			item.tokens = *cachedTokens;
+			item.parsed = true;
 		}
-		// directives
-		if (tokens.at(0) == ".inc" || tokens.at(0) == ".INC")
+		else if (line.find('.') != std::string::npos)
 		{
-			if (tokens.size() != 2)
-				error("invalid number of operands to " + tokens.at(0) + " directive.");
-			if (!sourceFileManager.addFile(tokens.at(1)))
-				error("cannot open source file '" + tokens.at(1) + "'.");
+			parseLine(line, item.tokens);
+			item.parsed = true;
 		}
-		else if (tokens.at(0) == ".org" || tokens.at(0) == ".ORG")
+
+		// stage 3 only takes the first token as directive, a label keeps the rest of its line in one token
+		std::string directive = item.tokens.empty() ? "" : item.tokens.at(0);
+
+		// includes and defines of a body take effect when stage 3 expands it, but this stage has read ahead by then
+		if (bodyNesting > 0 && (directive == ".inc" || directive == ".INC" || directive == ".def" || directive == ".DEF"))
 		{
-			if (tokens.size() != 2)
-			{
-				error("invalid number of operands to " + tokens.at(0) + " directive.");
-				continue;
-			}
+			tokens = std::move(item.tokens);
+			sequential = true;
+			break;
+		}
 
-			std::string baseReg;
-			std::string offset;
+		if (directive == ".macro" || directive == ".MACRO" || directive == ".rept" || directive == ".REPT" || directive == ".irp" || directive == ".IRP")
+			bodyNesting++;
 
-			if (!parseAddress(tokens.at(1), baseReg, offset))
-			{
-				error("invalid address '" + tokens.at(1) + "'.");
-				continue;
-			}
-			if (!baseReg.empty() || offset.empty())
-			{
-				error(tokens.at(0) + " directive only supports direct addressing.");
-				continue;
-			}
-			// if .org is used before any instruction, it overwrites the base pointer
-			if (objectCode.empty())
-				basePtr = toInt(offset, std::bind(&Compiler::error, this, std::placeholders::_1));
+		else if ((directive == ".endm" || directive == ".ENDM" || directive == ".endr" || directive == ".ENDR") && bodyNesting > 0)
+			bodyNesting--;
+
+		// includes and defines change the following lines, so they can not be passed on
+		else if (bodyNesting == 0 && (directive == ".inc" || directive == ".INC" || directive == ".def" || directive == ".DEF"))
+		{
+			tokens = std::move(item.tokens);
+
+			if (directive == ".inc" || directive == ".INC")
+				compileInclude();
 			else
-			{
-				int32_t n = toInt(offset, std::bind(&Compiler::error, this, std::placeholders::_1)) - basePtr;
-				if (n < static_cast<int32_t>(objectCode.size()))
-					error("overwriting existing object code.");
-				else
-					objectCode.resize(n, 0);
-			}
+				compileDefine();
+			continue;
 		}
-		else if (tokens.at(0) == ".def" || tokens.at(0) == ".DEF")
+
+		item.line = std::move(line);
+
+		if (messages.tellp() > 0)
 		{
-			// todo: auf redefines prfen 
-			if (tokens.size() != 3)
-				error("invalid number of operands to " + tokens.at(0) + " directive.");
-			else
-			{
-				// redefinition can never happen, because define replaces the identifier for all following defines to the same identifier
-				defines.push_back(std::make_pair(tokens.at(1), tokens.at(2)));
-			}
+			item.messages = messages.str();
+			messages.str("");
 		}
-		else if (tokens.at(0) == ".dw" || tokens.at(0) == ".DW")
+
+		batch.push_back(std::move(item));
+
+		if (batch.size() == pipelineBatchSize)
 		{
-			if (tokens.size() <= 1)
-			{
-				error("invalid number of operands to " + tokens.at(0) + " directive.");
-				continue;
-			}
+			readQueue.push(std::move(batch));
+			batch.clear();
+			batch.reserve(pipelineBatchSize);
+		}
+	}
 
-			std::vector<uint32_t> vecA, vecB;
+	PipelineLine end{};
+	end.messages = messages.str();
+	end.end = true;
+	batch.push_back(std::move(end));
+	readQueue.push(std::move(batch));
+
+	parser.join();
+	assembler.join();
+	log = output;
+
+	// deferred instructions get encoded by compile
+	objectCode = std::move(encoder.objectCode);
+	deferredInstructions = std::move(encoder.deferredInstructions);
+	macros = std::move(encoder.macros);
+	macroDefinition = std::move(encoder.macroDefinition);
+	macroNesting = encoder.macroNesting;
+	repeatDefinition = std::move(encoder.repeatDefinition);
+	repeatValues = std::move(encoder.repeatValues);
+	repeatCount = encoder.repeatCount;
+	repeatNesting = encoder.repeatNesting;
+	expansionCount = encoder.expansionCount;
+	errorCount += encoder.errorCount;
+	warningCount += encoder.warningCount;
+
+	// the tokens of the line which stopped the pipeline are ready
+	if (sequential)
+	{
+		compileTokens();
+		compileLines();
+	}
+}
+
+std::vector<std::pair<std::string, size_t>> Compiler::getMemoryUsage()
+{
+	std::vector<std::pair<std::string, size_t>> usage = objectCode.getMemoryUsage();
+	size_t defineBytes = defines.capacity() * sizeof(std::pair<std::string, std::string>);
+
+	for (std::pair<std::string, std::string>& define : defines)
+		defineBytes += define.first.capacity() + define.second.capacity();
 
-			for (size_t i = 1; i < tokens.size(); i++)
+	usage.push_back(std::make_pair("Compiler::defines", defineBytes));
+	return usage;
+}
+
+bool Compiler::compileConditional()
+{
+	// cheap scan for a conditional directive, inactive regions are never parsed
+	std::string directive = getDirective(line);
+	std::string operand;
+
+	if (!isConditional(directive))
+		return false;
+
+	operand = line.substr(line.find(directive) + directive.size());
+	operand = operand.substr(0, find_first_of_outside_str(operand, ";"));	// cut comment
+	operand.erase(0, operand.find_first_not_of(" \t"));					// cut whitespaces left
+	operand.erase(operand.find_last_not_of(" \t\n") + 1);					// cut whitespaces right
+
+	compileConditional(directive, operand, true);
+	return true;
+}
+
+// defines of expanded bodies were already replaced when the body was recorded
+void Compiler::compileConditional(const std::string& directive, const std::string& operand, bool replace)
+{
+	bool parentActive = conditionals.empty() || conditionals.back().active;
+
+	if (directive == ".if" || directive == ".IF" || directive == ".ifdef" || directive == ".IFDEF" || directive == ".ifndef" || directive == ".IFNDEF")
+	{
+		bool condition = false;
+
+		// conditions inside of inactive regions are not evaluated
+		if (parentActive)
+		{
+			if (operand.empty())
+				error("invalid number of operands to " + directive + " directive.");
+
+			else if (directive == ".if" || directive == ".IF")
+				condition = evaluateCondition(operand, replace);
+
+			else
 			{
-				vecA = toWordArray(tokens.at(i), std::bind(&Compiler::error, this, std::placeholders::_1));
-				vecB.insert(vecB.end(), vecA.begin(), vecA.end());
+				bool defined = false;
+				for (std::pair<std::string, std::string>& define : defines)
+				{
+					if (define.first == operand)
+					{
+						defined = true;
+						break;
+					}
+				}
+				condition = (directive == ".ifdef" || directive == ".IFDEF") ? defined : !defined;
 			}
-
-			objectCode.append(vecB);
 		}
-		// instructions
-		else if (tokens.at(0) == "nop" || tokens.at(0) == "NOP")
-			addInst_noOperands(static_cast<uint8_t>(INST::NOP));
 
-		else if (tokens.at(0) == "inr" || tokens.at(0) == "INR")
-			addInst_dstA_imm(static_cast<uint8_t>(INST::INR), 0, toWord);
+		// inactive parents count as taken, so no branch of the nested block becomes active
+		conditionals.push_back(Conditional{ parentActive && condition, !parentActive || condition, false });
+		return;
+	}
 
-		else if (tokens.at(0) == "mov" || tokens.at(0) == "MOV")
-			addInst_srcB_dstA(static_cast<uint8_t>(INST::MOV));
+	// an expanded body can not close the conditionals around it
+	if (conditionals.size() <= conditionalBase)
+	{
+		error(directive + " directive without matching .if directive.");
+		return;
+	}
 
-		else if (tokens.at(0) == "stm" || tokens.at(0) == "STM")
-			addInst_srcB_addr(static_cast<uint8_t>(INST::STM));
+	Conditional& conditional = conditionals.back();
 
-		else if (tokens.at(0) == "ldm" || tokens.at(0) == "LDM")
-			addInst_dstA_addr(static_cast<uint8_t>(INST::LDM));
+	if (directive == ".endif" || directive == ".ENDIF")
+	{
+		if (!operand.empty())
+			error("invalid number of operands to " + directive + " directive.");
 
-		else if (tokens.at(0) == "push" || tokens.at(0) == "PUSH")
-			addInst_srcB(static_cast<uint8_t>(INST::PUSH));
+		conditionals.pop_back();
+	}
+	else if (conditional.hasElse)
+		error(directive + " directive after .else directive.");
 
-		else if (tokens.at(0) == "pop" || tokens.at(0) == "POP")
-			addInst_dstA(static_cast<uint8_t>(INST::POP));
+	else if (directive == ".else" || directive == ".ELSE")
+	{
+		if (!operand.empty())
+			error("invalid number of operands to " + directive + " directive.");
 
-		else if (tokens.at(0) == "add" || tokens.at(0) == "ADD")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::ADD));
+		conditional.active = !conditional.taken;
+		conditional.taken = true;
+		conditional.hasElse = true;
+	}
+	// .elif
+	else
+	{
+		if (operand.empty())
+			error("invalid number of operands to " + directive + " directive.");
 
-		else if (tokens.at(0) == "adc" || tokens.at(0) == "ADC")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::ADC));
+		conditional.active = !conditional.taken && evaluateCondition(operand, replace);
+		conditional.taken = conditional.taken || conditional.active;
+	}
+}
 
-		else if (tokens.at(0) == "sub" || tokens.at(0) == "SUB")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::SUB));
+bool Compiler::evaluateCondition(std::string condition, bool replace)
+{
+	if (replace)
+		replaceDefines(condition);
 
-		else if (tokens.at(0) == "sbc" || tokens.at(0) == "SBC")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::SBC));
+	try { return evaluateExpression(condition) != 0; }
+	catch (std::invalid_argument&) { error("cannot evaluate condition '" + condition + "'."); }
+	catch (std::out_of_range&) { error("cannot evaluate condition '" + condition + "'."); }
 
-		else if (tokens.at(0) == "umul" || tokens.at(0) == "UMUL")
-			addInst_srcA_srcB_dstA_dstB(static_cast<uint8_t>(INST::MUL), static_cast<uint8_t>(MUL_FUNC::UMUL));
+	return false;
+}
 
-		else if (tokens.at(0) == "smul" || tokens.at(0) == "SMUL")
-			addInst_srcA_srcB_dstA_dstB(static_cast<uint8_t>(INST::MUL), static_cast<uint8_t>(MUL_FUNC::SMUL));
+bool Compiler::replaceDefines(std::string& str)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::DEFINES };
+	bool replaced = false;
 
-		else if (tokens.at(0) == "udiv" || tokens.at(0) == "UDIV")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::DIV), static_cast<uint8_t>(DIV_FUNC::UDIV));
+	for (std::pair<std::string, std::string>& define : defines)
+	{
+		size_t pos = str.find(define.first);
 
-		else if (tokens.at(0) == "sdiv" || tokens.at(0) == "SDIV")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::DIV), static_cast<uint8_t>(DIV_FUNC::SDIV));
+		while (pos != std::string::npos)
+		{
+			str.replace(pos, define.first.length(), define.second);
+			pos = str.find(define.first, pos + define.second.length());
+			replaced = true;
+		}
+	}
 
-		else if (tokens.at(0) == "umod" || tokens.at(0) == "UMOD")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::DIV), static_cast<uint8_t>(DIV_FUNC::UMOD));
+	return replaced;
+}
 
-		else if (tokens.at(0) == "smod" || tokens.at(0) == "SMOD")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::DIV), static_cast<uint8_t>(DIV_FUNC::SMOD));
+void Compiler::compileTokens()
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::ENCODE };
+	// skip empty lines
+	if (tokens.empty())
+		return;
 
-		else if (tokens.at(0) == "inc" || tokens.at(0) == "INC")
-			addInst_srcA_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::INC));
+	// macro body
+	if (macroDefinition)
+	{
+		recordMacro();
+		return;
+	}
+	// repeat block
+	if (repeatDefinition)
+	{
+		recordRepeat();
+		return;
+	}
 
-		else if (tokens.at(0) == "dec" || tokens.at(0) == "DEC")
-			addInst_srcA_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::DEC));
+	// conditionals of expanded bodies, the ones of source lines are handled before the line is parsed
+	if (isConditional(tokens.at(0)))
+	{
+		std::string operand;
 
-		else if (tokens.at(0) == "neg" || tokens.at(0) == "NEG")
-			addInst_srcA_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::NEG));
+		for (size_t i = 1; i < tokens.size(); i++)
+			operand += (i > 1 ? ", " : "") + tokens.at(i);
 
-		else if (tokens.at(0) == "and" || tokens.at(0) == "AND")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::AND));
+		compileConditional(tokens.at(0), operand, false);
+		return;
+	}
 
-		else if (tokens.at(0) == "or" || tokens.at(0) == "OR")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::OR));
+	// skip inactive regions of expanded bodies
+	if (!conditionals.empty() && !conditionals.back().active)
+		return;
 
-		else if (tokens.at(0) == "xor" || tokens.at(0) == "XOR")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::XOR));
+	// label
+	if (!tokens.at(0).empty() && tokens.at(0).back() == ':')
+	{
+		tokens.at(0).pop_back();
+		objectCode.addDereference(tokens.at(0), fileId, lineNumber);
+		tokens.erase(tokens.begin());
+		if (tokens.empty())
+			return;
+	}
 
-		else if (tokens.at(0) == "not" || tokens.at(0) == "NOT")
-			addInst_srcA_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::NOT));
+	// words of this line are mapped back to it
+	objectCode.addLine(fileId, lineNumber);
 
-		else if (tokens.at(0) == "lsl" || tokens.at(0) == "LSL")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::LSL));
+	// directives
+	if (tokens.at(0) == ".inc" || tokens.at(0) == ".INC")
+		compileInclude();
 
-		else if (tokens.at(0) == "lsr" || tokens.at(0) == "LSR")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::LSR));
+	else if (tokens.at(0) == ".org" || tokens.at(0) == ".ORG")
+	{
+		if (tokens.size() != 2)
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
 
-		else if (tokens.at(0) == "asr" || tokens.at(0) == "ASR")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::ASR));
+		std::string baseReg;
+		std::string offset;
 
-		else if (tokens.at(0) == "ror" || tokens.at(0) == "ROR")
-			addInst_srcA_srcB_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::ROR));
+		if (!parseAddress(tokens.at(1), baseReg, offset))
+		{
+			error("invalid address '" + tokens.at(1) + "'.");
+			return;
+		}
+		if (!baseReg.empty() || offset.empty())
+		{
+			error(tokens.at(0) + " directive only supports direct addressing.");
+			return;
+		}
+		// if .org is used before any instruction, it overwrites the base pointer
+		if (objectCode.empty())
+			objectCode.setBasePtr(toInt(offset, std::bind(&Compiler::error, this, std::placeholders::_1)));
+		else
+		{
+			int32_t n = toInt(offset, std::bind(&Compiler::error, this, std::placeholders::_1)) - objectCode.getBasePtr();
+			if (n < static_cast<int32_t>(objectCode.size()))
+				error("overwriting existing object code.");
+			else
+				objectCode.org(n);
+		}
+	}
+	else if (tokens.at(0) == ".def" || tokens.at(0) == ".DEF")
+		compileDefine();
 
-		else if (tokens.at(0) == "rrx" || tokens.at(0) == "RRX")
-			addInst_srcA_dstA(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::RRX));
+	else if (tokens.at(0) == ".macro" || tokens.at(0) == ".MACRO")
+		beginMacro();
 
-		else if (tokens.at(0) == "fadd" || tokens.at(0) == "FADD")
-			addInst_srcA_srcB_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::ADD) | static_cast<uint8_t>(FPU_RM::RNE));
+	else if (tokens.at(0) == ".endm" || tokens.at(0) == ".ENDM")
+		error(tokens.at(0) + " directive without matching .macro directive.");
 
-		else if (tokens.at(0) == "fsub" || tokens.at(0) == "FSUB")
-			addInst_srcA_srcB_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::SUB) | static_cast<uint8_t>(FPU_RM::RNE));
+	else if (tokens.at(0) == ".rept" || tokens.at(0) == ".REPT" || tokens.at(0) == ".irp" || tokens.at(0) == ".IRP")
+		beginRepeat();
 
-		else if (tokens.at(0) == "fmul" || tokens.at(0) == "FMUL")
-			addInst_srcA_srcB_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::MUL) | static_cast<uint8_t>(FPU_RM::RNE));
+	else if (tokens.at(0) == ".endr" || tokens.at(0) == ".ENDR")
+		error(tokens.at(0) + " directive without matching .rept or .irp directive.");
 
-		else if (tokens.at(0) == "fdiv" || tokens.at(0) == "FDIV")
-			addInst_srcA_srcB_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::DIV) | static_cast<uint8_t>(FPU_RM::RNE));
+	else if (tokens.at(0) == ".dw" || tokens.at(0) == ".DW")
+	{
+		if (tokens.size() <= 1)
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
 
-		else if (tokens.at(0) == "fsqrt" || tokens.at(0) == "FSQRT")
-			addInst_srcA_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::SQRT) | static_cast<uint8_t>(FPU_RM::RNE));
+		for (size_t i = 1; i < tokens.size(); i++)
+			objectCode.append(toWordArray(tokens.at(i), std::bind(&Compiler::error, this, std::placeholders::_1)));
+	}
+	// the checksum is computed after linking, its range ends before end_label
+	else if (tokens.at(0) == ".checksum" || tokens.at(0) == ".CHECKSUM")
+	{
+		if (tokens.size() != 4)
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
+		if (objectCode.isStreaming())
+		{
+			error(tokens.at(0) + " directive is not supported in streaming mode.");
+			return;
+		}
 
-		else if (tokens.at(0) == "fneg" || tokens.at(0) == "FNEG")
-			addInst_srcA_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::NEG));
+		CHECKSUM_TYPE type = toChecksumType(tokens.at(1), std::bind(&Compiler::error, this, std::placeholders::_1));
+		objectCode.addChecksum(type, tokens.at(2), tokens.at(3), fileId, lineNumber);
+	}
+	else if (tokens.at(0) == ".table" || tokens.at(0) == ".TABLE")
+	{
+		if (tokens.size() < 5)
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
 
-		else if (tokens.at(0) == "fabs" || tokens.at(0) == "FABS")
-			addInst_srcA_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::ABS));
+		TABLE_FUNC func = toTableFunction(tokens.at(1), std::bind(&Compiler::error, this, std::placeholders::_1));
+		uint32_t n = toInt(tokens.at(2), std::bind(&Compiler::error, this, std::placeholders::_1));
+		double scale = toReal(tokens.at(3), std::bind(&Compiler::error, this, std::placeholders::_1));
+		std::vector<double> coefficients;
 
-		else if (tokens.at(0) == "cvtfi" || tokens.at(0) == "CVTFI")
-			addInst_srcA_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::CVTFI) | static_cast<uint8_t>(FPU_RM::RTZ));
+		if (tokens.at(4) != "float" && tokens.at(4) != "FLOAT" && tokens.at(4) != "fixed" && tokens.at(4) != "FIXED")
+		{
+			error("unknown table format '" + tokens.at(4) + "'.");
+			return;
+		}
+		// only polynomials take coefficients
+		if ((func == TABLE_FUNC::POLY) != (tokens.size() > 5))
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
+		if (n > memorySize)
+		{
+			error("table size exceeds memory size.");
+			return;
+		}
 
-		else if (tokens.at(0) == "cvtfu" || tokens.at(0) == "CVTFU")
-			addInst_srcA_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::CVTFU) | static_cast<uint8_t>(FPU_RM::RTZ));
+		for (size_t i = 5; i < tokens.size(); i++)
+			coefficients.push_back(toReal(tokens.at(i), std::bind(&Compiler::error, this, std::placeholders::_1)));
 
-		else if (tokens.at(0) == "cvtif" || tokens.at(0) == "CVTIF")
-			addInst_srcA_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::CVTIF) | static_cast<uint8_t>(FPU_RM::RNE));
+		bool fixed = tokens.at(4) == "fixed" || tokens.at(4) == "FIXED";
+		objectCode.append(generateTable(func, n, scale, fixed, coefficients, std::bind(&Compiler::error, this, std::placeholders::_1)));
+	}
+	else if (tokens.at(0) == ".crctable" || tokens.at(0) == ".CRCTABLE")
+	{
+		if (tokens.size() != 3 && tokens.size() != 4)
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
 
-		else if (tokens.at(0) == "cvtuf" || tokens.at(0) == "CVTUF")
-			addInst_srcA_dstA_RM(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::CVTUF) | static_cast<uint8_t>(FPU_RM::RNE));
+		uint32_t poly = toInt(tokens.at(1), std::bind(&Compiler::error, this, std::placeholders::_1));
+		uint32_t width = toInt(tokens.at(2), std::bind(&Compiler::error, this, std::placeholders::_1));
+		bool reflected = false;
 
-		else if (tokens.at(0) == "cmp" || tokens.at(0) == "CMP")
-			addInst_srcA_srcB(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::SUB));
+		if (width != 8 && width != 16 && width != 32)
+		{
+			error("unsupported crc width '" + tokens.at(2) + "'.");
+			return;
+		}
+		if (tokens.size() == 4)
+		{
+			if (tokens.at(3) == "reflected" || tokens.at(3) == "REFLECTED")
+				reflected = true;
+			else if (tokens.at(3) != "normal" && tokens.at(3) != "NORMAL")
+			{
+				error("unknown crc bit order '" + tokens.at(3) + "'.");
+				return;
+			}
+		}
 
-		else if (tokens.at(0) == "cpc" || tokens.at(0) == "CPC")
-			addInst_srcA_srcB(static_cast<uint8_t>(INST::ALU), static_cast<uint8_t>(ALU_FUNC::SBC));
+		objectCode.append(generateCrcTable(poly, width, reflected));
+	}
+	// instructions
+	else if (const Instruction* instruction = findInstruction(tokens.at(0)))
+	{
+		if (parallel)
+			deferInstruction(*instruction);
+		else
+			addInstruction(*instruction);
+	}
+	// macros
+	else if (macros.count(tokens.at(0)))
+		expandMacro(macros.at(tokens.at(0)));
 
-		else if (tokens.at(0) == "fcmp" || tokens.at(0) == "FCMP")
-			addInst_srcA_srcB(static_cast<uint8_t>(INST::FPU), static_cast<uint8_t>(FPU_FUNC::CMP), toFloat);
+	// unknown instruction
+	else
+		error("unknown instruction '" + tokens.at(0) + "'.");
+}
 
-		else if (tokens.at(0) == "jeq" || tokens.at(0) == "JEQ" ||  tokens.at(0) == "jzs" || tokens.at(0) == "JZS")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JEQ));
+void Compiler::compileInclude()
+{
+	if (encodeOnly)
+	{
+		error(tokens.at(0) + " directive inside of macros is not supported in pipelined mode.");
+		return;
+	}
+	if (tokens.size() != 2)
+		error("invalid number of operands to " + tokens.at(0) + " directive.");
+	if (!sourceFileManager.addFile(tokens.at(1)))
+		error("cannot open source file '" + tokens.at(1) + "'.");
+}
 
-		else if (tokens.at(0) == "jne" || tokens.at(0) == "JNE" || tokens.at(0) == "jzc" || tokens.at(0) == "JZC")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JNE));
+void Compiler::compileDefine()
+{
+	// todo: auf redefines prfen 
+	if (encodeOnly)
+		error(tokens.at(0) + " directive inside of macros is not supported in pipelined mode.");
+	else if (tokens.size() != 3)
+		error("invalid number of operands to " + tokens.at(0) + " directive.");
+	else
+	{
+		// redefinition can never happen, because define replaces the identifier for all following defines to the same identifier
+		defines.push_back(std::make_pair(tokens.at(1), tokens.at(2)));
+	}
+}
 
-		else if (tokens.at(0) == "jhi" || tokens.at(0) == "JHI")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JHI));
+void Compiler::beginMacro()
+{
+	if (tokens.size() < 2)
+	{
+		error("invalid number of operands to " + tokens.at(0) + " directive.");
+		return;
+	}
 
-		else if (tokens.at(0) == "jsh" || tokens.at(0) == "JSH" || tokens.at(0) == "jcc" || tokens.at(0) == "JCC")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JSH));
+	// 1st operand contains the name and the 1st parameter, separated by whitespaces
+	std::string name = tokens.at(1).substr(0, tokens.at(1).find_first_of(" \t"));
+	std::vector<std::string> params;
 
-		else if (tokens.at(0) == "jsl" || tokens.at(0) == "JSL")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JSL));
+	if (name.size() != tokens.at(1).size())
+	{
+		params.push_back(tokens.at(1).substr(name.size()));
+		params.back().erase(0, params.back().find_first_not_of(" \t"));
+	}
+	params.insert(params.end(), tokens.begin() + 2, tokens.end());
 
-		else if (tokens.at(0) == "jlo" || tokens.at(0) == "JLO" || tokens.at(0) == "jcs" || tokens.at(0) == "JCS")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JLO));
+	for (std::string& param : params)
+	{
+		if (param.empty() || param.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != std::string::npos)
+			error("invalid macro parameter '" + param + "'.");
+	}
 
-		else if (tokens.at(0) == "jgt" || tokens.at(0) == "JGT")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JGT));
+	if (macros.count(name))
+		error("redefinition of macro '" + name + "'.");
 
-		else if (tokens.at(0) == "jge" || tokens.at(0) == "JGE" || tokens.at(0) == "jsc" || tokens.at(0) == "JSC")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JGE));
+	// instructions are looked up first, so the macro could never be expanded
+	if (findInstruction(name))
+		error("macro '" + name + "' has the name of an instruction.");
 
-		else if (tokens.at(0) == "jle" || tokens.at(0) == "JLE")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JLE));
+	macroDefinition = std::make_unique<Macro>(name, params);
+	macroNesting = 0;
+}
 
-		else if (tokens.at(0) == "jlt" || tokens.at(0) == "JLT" || tokens.at(0) == "jss" || tokens.at(0) == "JSS")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JLT));
+void Compiler::recordMacro()
+{
+	// nested definitions are recorded as part of the body and get defined when the outer macro is expanded
+	if (tokens.at(0) == ".macro" || tokens.at(0) == ".MACRO")
+		macroNesting++;
 
-		else if (tokens.at(0) == "jmi" || tokens.at(0) == "JMI" || tokens.at(0) == "jns" || tokens.at(0) == "JNS")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JMI));
+	else if (tokens.at(0) == ".endm" || tokens.at(0) == ".ENDM")
+	{
+		if (macroNesting == 0)
+		{
+			if (tokens.size() != 1)
+				error("invalid number of operands to " + tokens.at(0) + " directive.");
 
-		else if (tokens.at(0) == "jpl" || tokens.at(0) == "JPL" || tokens.at(0) == "jnc" || tokens.at(0) == "JNC")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JPL));
+			std::string name = macroDefinition->getName();
+			if (!macros.count(name))
+				macros.emplace(name, std::move(*macroDefinition));
 
-		else if (tokens.at(0) == "jvs" || tokens.at(0) == "JVS")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JVS));
+			macroDefinition.reset();
+			return;
+		}
 
-		else if (tokens.at(0) == "jvc" || tokens.at(0) == "JVC")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JVC));
+		macroNesting--;
+	}
 
-		else if (tokens.at(0) == "jmp" || tokens.at(0) == "JMP")
-			addInst_addr(static_cast<uint8_t>(INST::JMP), static_cast<uint8_t>(JMP_FUNC::JAL));
+	macroDefinition->addLine(tokens);
+}
 
-		else if (tokens.at(0) == "ien" || tokens.at(0) == "IEN")
-			addInst_noOperands(static_cast<uint8_t>(INST::IEN));
+void Compiler::expandMacro(Macro& macro)
+{
+	if (tokens.size() - 1 != macro.getParamCount())
+	{
+		error("invalid number of arguments to macro '" + macro.getName() + "'.");
+		return;
+	}
+	if (expansionDepth >= maxExpansionDepth)
+	{
+		error("expansion of macro '" + macro.getName() + "' is nested too deeply.");
+		return;
+	}
 
-		else if (tokens.at(0) == "idi" || tokens.at(0) == "IDI")
-			addInst_noOperands(static_cast<uint8_t>(INST::IDI));
+	std::vector<std::string> args(tokens.begin() + 1, tokens.end());
+	unsigned int id = expansionCount++;
+	size_t base = conditionalBase;
 
-		else if (tokens.at(0) == "wait" || tokens.at(0) == "WAIT")
-			addInst_noOperands(static_cast<uint8_t>(INST::WAIT));
+	// body tokens are substituted directly, no need to parse or replace defines again
+	expansionDepth++;
+	conditionalBase = conditionals.size();
+	for (size_t i = 0; i < macro.getLineCount(); i++)
+	{
+		macro.expandLine(i, args, id, tokens);
+		compileTokens();
+	}
+	closeConditionals("macro '" + macro.getName() + "'");
+	conditionalBase = base;
+	expansionDepth--;
+}
 
-		else if (tokens.at(0) == "reti" || tokens.at(0) == "RETI")
-			addInst_noOperands(static_cast<uint8_t>(INST::RETI));
+void Compiler::beginRepeat()
+{
+	std::vector<std::string> params;
 
-		else if (tokens.at(0) == "call" || tokens.at(0) == "CALL")
-			addInst_addr(static_cast<uint8_t>(INST::CALL));
+	repeatValues.clear();
+	repeatCount = 0;
+	repeatNesting = 0;
 
-		else if (tokens.at(0) == "ret" || tokens.at(0) == "RET")
-			addInst_noOperands(static_cast<uint8_t>(INST::RET));
+	// .rept count[, index]
+	if (tokens.at(0) == ".rept" || tokens.at(0) == ".REPT")
+	{
+		if (tokens.size() != 2 && tokens.size() != 3)
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
 
-		// unknown instruction
+		int64_t count = static_cast<int32_t>(toInt(tokens.at(1), std::bind(&Compiler::error, this, std::placeholders::_1)));
+		if (count < 0)
+			error("negative repeat count '" + tokens.at(1) + "'.");
 		else
-			error("unknown instruction '" + tokens.at(0) + "'.");
+			repeatCount = static_cast<uint32_t>(count);
+
+		if (tokens.size() == 3)
+			params.push_back(tokens.at(2));
 	}
+	// .irp symbol, value_1, ..., value_n
+	else
+	{
+		if (tokens.size() < 2)
+		{
+			error("invalid number of operands to " + tokens.at(0) + " directive.");
+			return;
+		}
 
-	objectCode.link(errorCount);
-	
-	if (objectCode.size() > memorySize)
+		params.push_back(tokens.at(1));
+		repeatValues.assign(tokens.begin() + 2, tokens.end());
+		repeatCount = static_cast<uint32_t>(repeatValues.size());
+	}
+
+	for (std::string& param : params)
 	{
-		std::cout << "object code exceeds memory size by " << objectCode.size() - memorySize << " words." << std::endl;
-		errorCount++;
+		if (param.empty() || param.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != std::string::npos)
+			error("invalid repeat symbol '" + param + "'.");
 	}
-	else if (objectCode.size() < memorySize)
-		objectCode.resize(memorySize, 0);
 
-	sourceFileManager.closeAll();
+	repeatDefinition = std::make_unique<Macro>(tokens.at(0), params);
+}
 
-	if (errorCount == 0)
+void Compiler::recordRepeat()
+{
+	if (tokens.at(0) == ".rept" || tokens.at(0) == ".REPT" || tokens.at(0) == ".irp" || tokens.at(0) == ".IRP")
+		repeatNesting++;
+
+	else if (tokens.at(0) == ".endr" || tokens.at(0) == ".ENDR")
 	{
-		std::cout << "Compilation succeeded with " << warningCount << " warning(s)!" << std::endl;
-		return true;
+		if (repeatNesting == 0)
+		{
+			if (tokens.size() != 1)
+				error("invalid number of operands to " + tokens.at(0) + " directive.");
+
+			// the block may contain nested repeat blocks, which reuse the members
+			std::unique_ptr<Macro> block = std::move(repeatDefinition);
+			std::vector<std::string> values = std::move(repeatValues);
+			expandRepeat(*block, values, repeatCount);
+			return;
+		}
+
+		repeatNesting--;
 	}
-	else
+
+	repeatDefinition->addLine(tokens);
+}
+
+void Compiler::expandRepeat(Macro& block, std::vector<std::string>& values, uint32_t count)
+{
+	if (expansionDepth >= maxExpansionDepth)
 	{
-		std::cout << "Compilation failed with " << errorCount << " error(s) and " << warningCount << " warning(s)!" << std::endl;
-		objectCode.clear();
-		return false;
+		error("expansion of " + block.getName() + " block is nested too deeply.");
+		return;
+	}
+
+	std::vector<std::string> args(block.getParamCount());
+	size_t base = conditionalBase;
+
+	expansionDepth++;
+	conditionalBase = conditionals.size();
+	for (uint32_t n = 0; n < count; n++)
+	{
+		// .irp substitutes the nth value, .rept the iteration index
+		if (!args.empty())
+			args.at(0) = values.empty() ? std::to_string(n) : values.at(n);
+
+		unsigned int id = expansionCount++;
+
+		for (size_t i = 0; i < block.getLineCount(); i++)
+		{
+			block.expandLine(i, args, id, tokens);
+			compileTokens();
+		}
+
+		// every iteration starts outside of the conditionals of the block
+		closeConditionals(block.getName() + " block");
+	}
+	conditionalBase = base;
+	expansionDepth--;
+}
+
+void Compiler::closeConditionals(std::string block)
+{
+	if (conditionals.size() > conditionalBase)
+	{
+		error(std::to_string(conditionals.size() - conditionalBase) + " conditional block(s) of " + block + " missing .endif directive.");
+		conditionals.resize(conditionalBase);
+	}
+}
+
+void Compiler::deferInstruction(const Instruction& instruction)
+{
+	// only space is reserved, so labels get their final address
+	size_t size = getInstructionSize(instruction, tokens);
+	DeferredInstruction deferred{ &instruction, std::pmr::vector<std::pmr::string>(deferredInstructions.get_allocator()), fileId, lineNumber, objectCode.size(), size };
+
+	for (std::string& token : tokens)
+		deferred.tokens.emplace_back(token);
+
+	deferredInstructions.push_back(std::move(deferred));
+	objectCode.resize(objectCode.size() + size, 0);
+}
+
+void Compiler::encodeDeferredInstructions()
+{
+	if (deferredInstructions.empty())
+		return;
+
+	std::unordered_map<std::string, uint32_t> labels = objectCode.getLabels();
+	size_t chunkCount = (deferredInstructions.size() + encodeChunkSize - 1) / encodeChunkSize;
+	size_t threadCount = std::max<size_t>(1, std::min<size_t>(encodeThreads > 0 ? encodeThreads : std::thread::hardware_concurrency(), chunkCount));
+
+	// each chunk is encoded into a disjoint range of the object code and has its own log, so messages keep the source order
+	std::vector<Compiler> encoders(threadCount);
+	std::vector<std::ostringstream> logs(chunkCount);
+	std::vector<std::thread> threads;
+
+	auto encodeChunks = [&](size_t index)
+	{
+		Compiler& encoder = encoders.at(index);
+		encoder.labels = &labels;
+
+		for (size_t chunk = index; chunk < chunkCount; chunk += threadCount)
+		{
+			encoder.log = &logs.at(chunk);
+			size_t end = std::min(deferredInstructions.size(), (chunk + 1) * encodeChunkSize);
+
+			for (size_t i = chunk * encodeChunkSize; i < end; i++)
+			{
+				DeferredInstruction& deferred = deferredInstructions.at(i);
+				encoder.objectCode.clear();
+				encoder.fileId = deferred.fileId;
+				encoder.lineNumber = deferred.lineNumber;
+				encoder.tokens.clear();
+
+				for (std::pmr::string& token : deferred.tokens)
+					encoder.tokens.emplace_back(token);
+
+				encoder.addInstruction(*deferred.instruction);
+
+				if (encoder.objectCode.size() == deferred.size)
+					objectCode.write(deferred.pos, encoder.objectCode);
+				else
+					encoder.error("instruction size does not match reserved size.");
+			}
+		}
+	};
+
+	for (size_t i = 1; i < threadCount; i++)
+		threads.emplace_back(encodeChunks, i);
+
+	encodeChunks(0);
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (std::ostringstream& chunkLog : logs)
+		*log << chunkLog.str();
+
+	for (Compiler& encoder : encoders)
+	{
+		errorCount += encoder.errorCount;
+		warningCount += encoder.warningCount;
+	}
+
+	deferredInstructions.clear();
+}
+
+void Compiler::addInstruction(const Instruction& instruction)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::ENCODE };
+	uint8_t opcode = static_cast<uint8_t>(instruction.opcode);
+	std::function<uint32_t(std::string, std::function<void(std::string)>)> toImmediate = toInt;
+
+	if (instruction.immediate == IMMEDIATE_TYPE::WORD)
+		toImmediate = toWord;
+	else if (instruction.immediate == IMMEDIATE_TYPE::FLOAT)
+		toImmediate = toFloat;
+
+	switch (instruction.form)
+	{
+	case OPERAND_FORM::NONE:				addInst_noOperands(opcode, instruction.func);							break;
+	case OPERAND_FORM::DSTA_IMM:			addInst_dstA_imm(opcode, instruction.func, toImmediate);				break;
+	case OPERAND_FORM::SRCB_DSTA:			addInst_srcB_dstA(opcode, instruction.func);							break;
+	case OPERAND_FORM::SRCB_ADDR:			addInst_srcB_addr(opcode, instruction.func, toImmediate);				break;
+	case OPERAND_FORM::DSTA_ADDR:			addInst_dstA_addr(opcode, instruction.func, toImmediate);				break;
+	case OPERAND_FORM::SRCB:				addInst_srcB(opcode, instruction.func);									break;
+	case OPERAND_FORM::DSTA:				addInst_dstA(opcode, instruction.func);									break;
+	case OPERAND_FORM::SRCA_SRCB_DSTA:		addInst_srcA_srcB_dstA(opcode, instruction.func, toImmediate);			break;
+	case OPERAND_FORM::SRCA_SRCB_DSTA_DSTB:	addInst_srcA_srcB_dstA_dstB(opcode, instruction.func, toImmediate);		break;
+	case OPERAND_FORM::SRCA_DSTA:			addInst_srcA_dstA(opcode, instruction.func);							break;
+	case OPERAND_FORM::SRCA_SRCB_DSTA_RM:	addInst_srcA_srcB_dstA_RM(opcode, instruction.func, toImmediate);		break;
+	case OPERAND_FORM::SRCA_DSTA_RM:		addInst_srcA_dstA_RM(opcode, instruction.func);							break;
+	case OPERAND_FORM::SRCA_SRCB:			addInst_srcA_srcB(opcode, instruction.func, toImmediate);				break;
+	case OPERAND_FORM::ADDR:				addInst_addr(opcode, instruction.func, toImmediate);					break;
 	}
 }
 
 void Compiler::error(std::string message)
 {
-	std::cout << sourceFileManager.getPath() << ": line: " << sourceFileManager.getLineNumber() << ": error: " << message << std::endl;
+	*log << fileTable.getPath(fileId) << ": line: " << lineNumber << ": error: " << message << std::endl;
 	errorCount++;
 }
 
 void Compiler::warning(std::string message)
 {
-	std::cout << sourceFileManager.getPath() << ": line: " << sourceFileManager.getLineNumber() << ": warning: " << message << std::endl;
+	*log << fileTable.getPath(fileId) << ": line: " << lineNumber << ": warning: " << message << std::endl;
 	warningCount++;
 }
 
@@ -691,10 +1489,20 @@ void Compiler::addInst_addr(uint8_t opcode, uint8_t func, std::function<uint32_t
 			objectCode.append(immediate);
 		}
 	}
+	// label, already resolved
+	else if (labels)
+	{
+		auto it = labels->find(tokens.at(1));
+		objectCode.append(getMachineCode(opcode, true, func, 0x00, 0x00, 0x00));
+		objectCode.append(it != labels->end() ? it->second : 0x00000000);
+
+		if (it == labels->end())
+			error("cannot resolve '" + tokens.at(1) + "'.");
+	}
 	// label
 	else
 	{
 		objectCode.append(getMachineCode(opcode, true, func, 0x00, 0x00, 0x00));
-		objectCode.addReference(tokens.at(1), sourceFileManager.getPath(), sourceFileManager.getLineNumber());
+		objectCode.addReference(tokens.at(1), fileId, lineNumber);
 	}
 }
\ No newline at end of file
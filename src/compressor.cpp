@@ -0,0 +1,153 @@
+#include "compressor.h"
+#include "compiler.h"
+
+#include <sstream>
+#include <algorithm>
+
+// shorter runs are cheaper as literals, a run record takes two words
+const size_t minRunLength = 3;
+const uint32_t runFlag = 0x80000000;
+
+// decompressor, the compressed stream follows right after rle_data
+// inr takes no labels, so DATA is replaced by the address of rle_data
+static const char* decompressorSource = R"(
+	.org [ORG]
+	inr r1, DATA				; r1: read pointer
+	ldm r2, [r1]				; r2: write pointer
+	inc r1
+rle_next:
+	ldm r3, [r1]				; r3: record header
+	inc r1
+	cmp r3, 0
+	jeq rle_done
+	jmi rle_run
+rle_literal:
+	ldm r4, [r1]
+	inc r1
+	stm r4, [r2]
+	inc r2
+	dec r3
+	jne rle_literal
+	jmp rle_next
+rle_run:
+	and r3, 0x7FFFFFFF
+	ldm r4, [r1]				; r4: repeated word
+	inc r1
+rle_fill:
+	stm r4, [r2]
+	inc r2
+	dec r3
+	jne rle_fill
+	jmp rle_next
+rle_done:
+	jmp [ENTRY]
+rle_data:
+)";
+
+static std::string toHex(uint32_t value)
+{
+	std::ostringstream stream;
+	stream << "0x" << std::hex << value;
+	return stream.str();
+}
+
+std::vector<uint32_t> compressRle(const std::vector<uint32_t>& words, uint32_t address)
+{
+	std::vector<uint32_t> stream{ address };
+	size_t literalBegin = 0;
+
+	auto appendLiterals = [&](size_t end)
+	{
+		if (end == literalBegin)
+			return;
+
+		stream.push_back(static_cast<uint32_t>(end - literalBegin));
+		stream.insert(stream.end(), words.begin() + literalBegin, words.begin() + end);
+	};
+
+	for (size_t i = 0; i < words.size();)
+	{
+		size_t length = 1;
+		while (i + length < words.size() && words.at(i + length) == words.at(i))
+			length++;
+
+		if (length >= minRunLength)
+		{
+			appendLiterals(i);
+			stream.push_back(runFlag | static_cast<uint32_t>(length));
+			stream.push_back(words.at(i));
+			literalBegin = i + length;
+		}
+
+		i += length;
+	}
+
+	appendLiterals(words.size());
+	stream.push_back(0);
+	return stream;
+}
+
+bool buildBootImage(const std::vector<uint32_t>& words, uint32_t address, uint32_t org, std::vector<uint32_t>& image, std::ostream& log)
+{
+	size_t length = words.size();
+
+	// the decompressor may only use the zero filled end of the object code
+	if (org >= address && org < address + words.size())
+	{
+		length = org - address;
+
+		if (std::any_of(words.begin() + length, words.end(), [](uint32_t word) { return word != 0; }))
+		{
+			log << "Fatal: object code overlaps the decompressor at " << toHex(org) << "!" << std::endl;
+			return false;
+		}
+	}
+
+	Compiler compiler;
+	uint32_t data = org;
+
+	// the size of the decompressor does not depend on DATA, the 1st pass only locates rle_data
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::string source = decompressorSource;
+		source.replace(source.find("ORG"), 3, toHex(org));
+		source.replace(source.find("DATA"), 4, toHex(data));
+		source.replace(source.find("ENTRY"), 5, toHex(address));
+
+		std::ostringstream compilerLog;
+		std::istringstream stream{ source };
+		compiler.setLog(compilerLog);
+
+		if (!compiler.compileStream("<decompressor>", stream))
+		{
+			log << compilerLog.str();
+			return false;
+		}
+
+		data = compiler.objectCode.getLabels().at("rle_data");
+	}
+
+	size_t stubSize = data - org;
+	const std::vector<uint32_t>& stub = compiler.objectCode.getData();
+	std::vector<uint32_t> unpacked{ words.begin(), words.begin() + length };
+
+	image.assign(1, org);
+	image.insert(image.end(), stub.begin(), stub.begin() + stubSize);
+	std::vector<uint32_t> compressed = compressRle(unpacked, address);
+	image.insert(image.end(), compressed.begin(), compressed.end());
+
+	// the stream must not be overwritten before it is read
+	size_t loadSize = image.size() - 1;
+	if (org < address + length && org + loadSize > address)
+	{
+		log << "Fatal: decompressor at " << toHex(org) << " overlaps the object code!" << std::endl;
+		return false;
+	}
+	if (org >= address && org < address + words.size() && org + loadSize > address + words.size())
+	{
+		log << "Fatal: decompressor and compressed object code exceed memory size!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
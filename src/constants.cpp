@@ -1,3 +0,0 @@
-#include "constants.h"
-
-uint32_t basePtr = 0x00001000;
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include "converter.h"
 #include "constants.h"
+#include "parser.h"
+#include "memoryReport.h"
 
 #include <limits>
+#include <cctype>
 
 void removeQuotes(std::string& str)
 {
@@ -86,7 +89,7 @@ bool isBin(std::string str)
 
 bool isInt(std::string str)
 {
-	return isDec(str) || isHex(str) || isBin(str);
+	return isDec(str) || isHex(str) || isBin(str) || isExpression(str);
 }
 
 bool isFloat(std::string str)
@@ -148,6 +151,10 @@ bool isRegister(std::string str)
 
 	if (str.at(0) == 'r' || str.at(0) == 'R')
 	{
+		// names like rtz are no registers
+		if (str.find_first_not_of("0123456789", 1) != std::string::npos)
+			return false;
+
 		int index = std::stoi(str.substr(1));
 		return index >= 0 && index <= 63;
 	}
@@ -157,8 +164,278 @@ bool isRegister(std::string str)
 			str == "pc" || str == "PC";
 }
 
+bool isExpression(std::string str)
+{
+	size_t startAt = 0;
+
+	if (!str.empty() && (str.at(0) == '+' || str.at(0) == '-'))
+		startAt = 1;
+
+	return str.size() >= startAt + 2 && str.at(startAt) == '(' && str.back() == ')';
+}
+
+static int64_t parseLogicalOr(std::string& str, size_t& pos);
+
+static void skipWhitespaces(std::string& str, size_t& pos)
+{
+	while (pos < str.size() && (str.at(pos) == ' ' || str.at(pos) == '\t'))
+		pos++;
+}
+
+// checks if the operator op follows at pos and is not the beginning of one of the longer operators
+static bool findOperator(std::string& str, size_t& pos, std::string op, std::string longerOps = "")
+{
+	skipWhitespaces(str, pos);
+
+	if (str.compare(pos, op.size(), op) != 0)
+		return false;
+
+	if (pos + op.size() < str.size() && contains(longerOps, str.at(pos + op.size())))
+		return false;
+
+	pos += op.size();
+	return true;
+}
+
+static int64_t parsePrimary(std::string& str, size_t& pos)
+{
+	skipWhitespaces(str, pos);
+
+	if (pos >= str.size())
+		throw std::invalid_argument{ "invalid argument" };
+
+	char c = str.at(pos);
+
+	if (c == '(')
+	{
+		pos++;
+		int64_t val = parseLogicalOr(str, pos);
+		skipWhitespaces(str, pos);
+		if (pos >= str.size() || str.at(pos) != ')')
+			throw std::invalid_argument{ "invalid argument" };
+		pos++;
+		return val;
+	}
+	if (c == '-')
+		return -parsePrimary(str, ++pos);
+
+	if (c == '+')
+		return parsePrimary(str, ++pos);
+
+	if (c == '~')
+		return ~parsePrimary(str, ++pos);
+
+	if (c == '!')
+		return !parsePrimary(str, ++pos);
+
+	size_t end = pos;
+
+	// char literal
+	if (c == '\'')
+	{
+		end++;
+		if (end < str.size() && str.at(end) == '\\')
+			end++;
+		end += 2;
+	}
+	else
+	{
+		while (end < str.size() && (std::isalnum(static_cast<unsigned char>(str.at(end))) || str.at(end) == '_'))
+			end++;
+	}
+
+	if (end > str.size() || end == pos)
+		throw std::invalid_argument{ "invalid argument" };
+
+	std::string literal = str.substr(pos, end - pos);
+	pos = end;
+
+	if (isBin(literal))
+		return std::stoll(literal.substr(2), nullptr, 2);
+
+	if (isHex(literal))
+		return std::stoll(literal, nullptr, 16);
+
+	if (isDec(literal))
+		return std::stoll(literal, nullptr, 10);
+
+	return toChar(literal);
+}
+
+static int64_t parseProduct(std::string& str, size_t& pos)
+{
+	int64_t val = parsePrimary(str, pos);
+
+	while (true)
+	{
+		if (findOperator(str, pos, "*"))
+			val *= parsePrimary(str, pos);
+
+		else if (findOperator(str, pos, "/") || findOperator(str, pos, "%"))
+		{
+			bool div = str.at(pos - 1) == '/';
+			int64_t rhs = parsePrimary(str, pos);
+
+			if (rhs == 0)
+				throw std::invalid_argument{ "invalid argument" };
+
+			// the quotient does not fit and the division traps
+			if (rhs == -1 && val == std::numeric_limits<int64_t>::min())
+				throw std::out_of_range{ "out of range" };
+
+			val = div ? val / rhs : val % rhs;
+		}
+		else
+			return val;
+	}
+}
+
+static int64_t parseSum(std::string& str, size_t& pos)
+{
+	int64_t val = parseProduct(str, pos);
+
+	while (true)
+	{
+		if (findOperator(str, pos, "+"))
+			val += parseProduct(str, pos);
+
+		else if (findOperator(str, pos, "-"))
+			val -= parseProduct(str, pos);
+
+		else
+			return val;
+	}
+}
+
+static int64_t parseShift(std::string& str, size_t& pos)
+{
+	int64_t val = parseSum(str, pos);
+
+	while (true)
+	{
+		// negative values are shifted as unsigned, shifting them left is undefined
+		if (findOperator(str, pos, "<<"))
+			val = static_cast<int64_t>(static_cast<uint64_t>(val) << (parseSum(str, pos) & 0x3F));
+
+		else if (findOperator(str, pos, ">>"))
+			val >>= parseSum(str, pos) & 0x3F;
+
+		else
+			return val;
+	}
+}
+
+static int64_t parseRelational(std::string& str, size_t& pos)
+{
+	int64_t val = parseShift(str, pos);
+
+	while (true)
+	{
+		if (findOperator(str, pos, "<="))
+			val = val <= parseShift(str, pos);
+
+		else if (findOperator(str, pos, ">="))
+			val = val >= parseShift(str, pos);
+
+		else if (findOperator(str, pos, "<", "<="))
+			val = val < parseShift(str, pos);
+
+		else if (findOperator(str, pos, ">", ">="))
+			val = val > parseShift(str, pos);
+
+		else
+			return val;
+	}
+}
+
+static int64_t parseEquality(std::string& str, size_t& pos)
+{
+	int64_t val = parseRelational(str, pos);
+
+	while (true)
+	{
+		if (findOperator(str, pos, "=="))
+			val = val == parseRelational(str, pos);
+
+		else if (findOperator(str, pos, "!="))
+			val = val != parseRelational(str, pos);
+
+		else
+			return val;
+	}
+}
+
+static int64_t parseAnd(std::string& str, size_t& pos)
+{
+	int64_t val = parseEquality(str, pos);
+
+	while (findOperator(str, pos, "&", "&"))
+		val &= parseEquality(str, pos);
+
+	return val;
+}
+
+static int64_t parseXor(std::string& str, size_t& pos)
+{
+	int64_t val = parseAnd(str, pos);
+
+	while (findOperator(str, pos, "^"))
+		val ^= parseAnd(str, pos);
+
+	return val;
+}
+
+static int64_t parseOr(std::string& str, size_t& pos)
+{
+	int64_t val = parseXor(str, pos);
+
+	while (findOperator(str, pos, "|", "|"))
+		val |= parseXor(str, pos);
+
+	return val;
+}
+
+static int64_t parseLogicalAnd(std::string& str, size_t& pos)
+{
+	int64_t val = parseOr(str, pos);
+
+	while (findOperator(str, pos, "&&"))
+	{
+		int64_t rhs = parseOr(str, pos);
+		val = val && rhs;
+	}
+
+	return val;
+}
+
+static int64_t parseLogicalOr(std::string& str, size_t& pos)
+{
+	int64_t val = parseLogicalAnd(str, pos);
+
+	while (findOperator(str, pos, "||"))
+	{
+		int64_t rhs = parseLogicalAnd(str, pos);
+		val = val || rhs;
+	}
+
+	return val;
+}
+
+int64_t evaluateExpression(std::string str)
+{
+	size_t pos = 0;
+	int64_t val = parseLogicalOr(str, pos);
+
+	skipWhitespaces(str, pos);
+	if (pos != str.size())
+		throw std::invalid_argument{ "invalid argument" };
+
+	return val;
+}
+
 uint32_t toInt(std::string str, std::function<void(std::string)> errorFunc)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
 	int64_t _val;
 
 	try
@@ -193,6 +470,14 @@ uint32_t toInt(std::string str, std::function<void(std::string)> errorFunc)
 			return static_cast<uint32_t>(_val);
 		}
 
+		if (isExpression(str))
+		{
+			_val = evaluateExpression(str);
+			if (_val < std::numeric_limits<int32_t>::min() || _val > std::numeric_limits<uint32_t>::max())
+				throw std::out_of_range{ "out of range" };
+			return static_cast<uint32_t>(_val);
+		}
+
 		return toChar(str);
 	}
 	catch (std::invalid_argument&)
@@ -214,6 +499,39 @@ uint32_t toInt(std::string str, std::function<void(std::string)> errorFunc)
 }
 
 uint32_t toFloat(std::string str, std::function<void(std::string)> errorFunc)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
+	try
+	{
+		if (str.empty() || isInt(str))
+			throw std::invalid_argument{ "invalid argument" };
+
+		size_t len;
+		float val = std::stof(str, &len);
+		if (len != str.size())
+			throw std::invalid_argument{ "invalid argument" };
+
+		return floatToWord(val);
+	}
+	catch (std::invalid_argument&)
+	{
+		if (errorFunc)
+			errorFunc("cannot convert '" + str + "' to float.");
+		else
+			throw;
+	}
+	catch (std::out_of_range&)
+	{
+		if (errorFunc)
+			errorFunc("'" + str + "' cannot be represented with 32 bit.");
+		else
+			throw;
+	}
+
+	return 0;
+}
+
+uint32_t floatToWord(float val)
 {
 	union Float
 	{
@@ -221,38 +539,46 @@ uint32_t toFloat(std::string str, std::function<void(std::string)> errorFunc)
 		uint32_t hex;
 	} f;
 
+	f.val = val;
+	return f.hex;
+}
+
+double toReal(std::string str, std::function<void(std::string)> errorFunc)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
 	try
 	{
-		if (str.empty() || isInt(str))
-			throw std::invalid_argument{ "invalid argument" };
+		if (isInt(str))
+			return static_cast<double>(static_cast<int32_t>(toInt(str)));
 
 		size_t len;
-		f.val = std::stof(str, &len);
+		double val = std::stod(str, &len);
 		if (len != str.size())
 			throw std::invalid_argument{ "invalid argument" };
 
-		return f.hex;
+		return val;
 	}
 	catch (std::invalid_argument&)
 	{
 		if (errorFunc)
-			errorFunc("cannot convert '" + str + "' to float.");
+			errorFunc("cannot convert '" + str + "' to real number.");
 		else
 			throw;
 	}
 	catch (std::out_of_range&)
 	{
 		if (errorFunc)
-			errorFunc("'" + str + "' cannot be represented with 32 bit.");
+			errorFunc("'" + str + "' is out of range.");
 		else
 			throw;
 	}
 
-	return 0;
+	return 0.0;
 }
 
 uint32_t toChar(std::string str, std::function<void(std::string)> errorFunc)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
 	try
 	{
 		if (!isChar(str))
@@ -312,6 +638,7 @@ uint32_t toChar(std::string str, std::function<void(std::string)> errorFunc)
 
 uint32_t toWord(std::string str, std::function<void(std::string)> errorFunc)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
 	try { return toInt(str); }
 	catch (std::invalid_argument&)
 	{
@@ -327,6 +654,7 @@ uint32_t toWord(std::string str, std::function<void(std::string)> errorFunc)
 
 std::vector<uint32_t> toString(std::string str, std::function<void(std::string)> errorFunc)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
 	std::string currentChar;
 	bool escapeChar = false;
 	std::vector<uint32_t> chars;
@@ -418,7 +746,8 @@ std::vector<uint32_t> toString(std::string str, std::function<void(std::string)>
 
 std::vector<uint32_t> toWordArray(std::string str, std::function<void(std::string)> errorFunc)
 {
-	try { return std::vector<uint32_t>{1, toWord(str)}; }
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
+	try { return std::vector<uint32_t>(1, toWord(str)); }
 	catch (std::invalid_argument&)
 	{
 		try { return toString(str); }
@@ -433,6 +762,7 @@ std::vector<uint32_t> toWordArray(std::string str, std::function<void(std::strin
 
 uint8_t toRegister(std::string str, std::function<void(std::string)> errorFunc)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::CONVERT };
 	try
 	{
 		if (str.size() < 2)
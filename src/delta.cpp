@@ -0,0 +1,100 @@
+#include "delta.h"
+#include "checksum.h"
+
+#include <fstream>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DELTA_SSE2
+#endif
+
+// unchanged gaps shorter than a range header are cheaper to send again
+const size_t rangeHeaderSize = 3;
+
+// first position from pos on where the words of both images are equal or differ, depending on equal
+static size_t findNext(const uint32_t* a, const uint32_t* b, size_t pos, size_t count, bool equal)
+{
+#ifdef DELTA_SSE2
+	// four words per compare, one movemask bit per byte
+	for (; pos + 4 <= count; pos += 4)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + pos));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + pos));
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(x, y));
+
+		if (equal ? mask != 0 : mask != 0xFFFF)
+			break;
+	}
+#endif
+
+	while (pos < count && (a[pos] == b[pos]) != equal)
+		pos++;
+
+	return pos;
+}
+
+bool readImage(std::string path, std::vector<uint32_t>& words)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+		return false;
+
+	std::streamsize size = file.tellg();
+	file.seekg(0);
+	words.resize(static_cast<size_t>(size) / sizeof(uint32_t));
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint32_t)));
+}
+
+std::vector<DeltaRange> findChangedRanges(const std::vector<uint32_t>& previous, const std::vector<uint32_t>& current)
+{
+	std::vector<DeltaRange> ranges;
+	size_t common = std::min(previous.size(), current.size());
+	size_t pos = 0;
+
+	while (pos < common)
+	{
+		size_t begin = findNext(previous.data(), current.data(), pos, common, false);
+		if (begin == common)
+			break;
+
+		size_t end = findNext(previous.data(), current.data(), begin, common, true);
+
+		if (!ranges.empty() && begin - (ranges.back().begin + ranges.back().count) < rangeHeaderSize)
+			ranges.back().count = end - ranges.back().begin;
+		else
+			ranges.push_back({ begin, end - begin });
+
+		pos = end;
+	}
+
+	// words the previous image did not have
+	if (current.size() > common)
+	{
+		if (!ranges.empty() && common - (ranges.back().begin + ranges.back().count) < rangeHeaderSize)
+			ranges.back().count = current.size() - ranges.back().begin;
+		else
+			ranges.push_back({ common, current.size() - common });
+	}
+
+	return ranges;
+}
+
+std::vector<uint32_t> buildDelta(const std::vector<uint32_t>& previous, const std::vector<uint32_t>& current, uint32_t address)
+{
+	std::vector<DeltaRange> ranges = findChangedRanges(previous, current);
+	std::vector<uint32_t> delta{ deltaMagic, address, static_cast<uint32_t>(ranges.size()), crc32(current) };
+
+	for (DeltaRange& range : ranges)
+	{
+		const uint32_t* words = current.data() + range.begin;
+
+		delta.push_back(address + static_cast<uint32_t>(range.begin));
+		delta.push_back(static_cast<uint32_t>(range.count));
+		delta.push_back(crc32(words, range.count));
+		delta.insert(delta.end(), words, words + range.count);
+	}
+
+	return delta;
+}
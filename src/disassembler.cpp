@@ -0,0 +1,486 @@
+#include "disassembler.h"
+#include "converter.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <cstdio>
+
+const size_t opcodeCount = 32;
+const size_t funcCount = 256;
+const size_t minRepeatLength = 4;		// shorter runs of equal words are listed one by one
+const size_t instructionColumn = 40;	// the address and the words of an instruction are listed behind it
+const size_t locationColumn = 24;
+const size_t traceBatchSize = 1 << 16;	// samples per write to the file
+
+static const char* const roundingModes[] = { "rne", "rmm", "rtz", "rdn", "rup" };
+
+// func bits which select the instruction, the others hold operands
+static uint8_t getFuncMask(uint8_t opcode)
+{
+	switch (static_cast<INST>(opcode))
+	{
+	case INST::MUL:	return 0x03;	// dst_b in bits 2 to 7
+	case INST::FPU:	return 0x0F;	// rounding mode in bits 4 to 6
+	default:		return 0xFF;
+	}
+}
+
+static const std::string& getRegisterName(uint8_t reg)
+{
+	static const std::vector<std::string> names = []()
+	{
+		std::vector<std::string> names;
+
+		for (unsigned int i = 0; i < 64; i++)
+			names.push_back("r" + std::to_string(i));
+
+		names.at(SP) = "sp";
+		names.at(SR) = "sr";
+		names.at(PC) = "pc";
+		return names;
+	}();
+
+	return names.at(reg & 0x3F);
+}
+
+static void appendHex(std::string& text, uint32_t value, unsigned int digits)
+{
+	static const char hexDigits[] = "0123456789abcdef";
+
+	for (unsigned int i = digits; i > 0; i--)
+		text += hexDigits[(value >> ((i - 1) * 4)) & 0x0F];
+}
+
+static void appendInt(std::string& text, uint32_t value)
+{
+	// small values are easier to read as decimal, everything else as word
+	int32_t signedValue = static_cast<int32_t>(value);
+
+	if (signedValue > -65536 && signedValue < 65536)
+		text += std::to_string(signedValue);
+	else
+	{
+		text += "0x";
+		appendHex(text, value, 8);
+	}
+}
+
+// float which converts back to the same word, false for values like NaN payloads
+static bool appendFloat(std::string& text, uint32_t value)
+{
+	union Float
+	{
+		uint32_t hex;
+		float val;
+	} f;
+
+	f.hex = value;
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "%.9g", f.val);
+	std::string str = buffer;
+
+	// integers are not accepted as float
+	if (str.find_first_of(".ein") == std::string::npos)
+		str += ".0";
+
+	try
+	{
+		if (toFloat(str) != value)
+			return false;
+	}
+	catch (std::exception&) { return false; }
+
+	text += str;
+	return true;
+}
+
+static void pad(std::string& text, size_t lineBegin, size_t column)
+{
+	size_t length = text.size() - lineBegin;
+	text.append(length < column ? column - length : 1, ' ');
+}
+
+// the word the compiler generates from the operands the form of instruction takes
+// any other bit set means that the word is not this instruction
+static bool isEncodable(const Instruction& instruction, uint32_t word)
+{
+	uint8_t opcode = static_cast<uint8_t>(instruction.opcode);
+	bool fetchImmediate = (word >> 26) & 0x01;
+	uint8_t func = (word >> 18) & 0xFF;
+	uint8_t srcA = (word >> 12) & 0x3F;
+	uint8_t srcB = (word >> 6) & 0x3F;
+	uint8_t dst = word & 0x3F;
+	uint8_t roundingMode = func & 0xF0;
+
+	switch (instruction.form)
+	{
+	case OPERAND_FORM::NONE:				return word == getMachineCode(opcode, false, instruction.func, 0x00, 0x00, 0x00);
+	case OPERAND_FORM::DSTA_IMM:			return word == getMachineCode(opcode, true, instruction.func, 0x00, 0x00, dst);
+	case OPERAND_FORM::SRCB_DSTA:			return word == getMachineCode(opcode, false, instruction.func, 0x00, srcB, dst);
+	case OPERAND_FORM::SRCB_ADDR:			return word == getMachineCode(opcode, fetchImmediate, instruction.func, srcA, srcB, 0x00);
+	case OPERAND_FORM::DSTA_ADDR:			return word == getMachineCode(opcode, fetchImmediate, instruction.func, srcA, 0x00, dst);
+	case OPERAND_FORM::SRCB:				return word == getMachineCode(opcode, false, instruction.func, 0x00, srcB, 0x00);
+	case OPERAND_FORM::DSTA:				return word == getMachineCode(opcode, false, instruction.func, 0x00, 0x00, dst);
+	case OPERAND_FORM::SRCA_SRCB_DSTA:		return word == getMachineCode(opcode, fetchImmediate, instruction.func, srcA, fetchImmediate ? 0x00 : srcB, dst);
+	case OPERAND_FORM::SRCA_SRCB_DSTA_DSTB:	return word == getMachineCode(opcode, fetchImmediate, instruction.func | (func & 0xFC), srcA, fetchImmediate ? 0x00 : srcB, dst);
+	case OPERAND_FORM::SRCA_DSTA:			return word == getMachineCode(opcode, false, instruction.func, srcA, 0x00, dst);
+	case OPERAND_FORM::SRCA_SRCB_DSTA_RM:	return roundingMode <= static_cast<uint8_t>(FPU_RM::RUP) && word == getMachineCode(opcode, fetchImmediate, (instruction.func & 0x0F) | roundingMode, srcA, fetchImmediate ? 0x00 : srcB, dst);
+	case OPERAND_FORM::SRCA_DSTA_RM:		return roundingMode <= static_cast<uint8_t>(FPU_RM::RUP) && word == getMachineCode(opcode, false, (instruction.func & 0x0F) | roundingMode, srcA, 0x00, dst);
+	case OPERAND_FORM::SRCA_SRCB:			return word == getMachineCode(opcode, fetchImmediate, instruction.func, srcA, fetchImmediate ? 0x00 : srcB, 0x00);
+	case OPERAND_FORM::ADDR:				return word == getMachineCode(opcode, fetchImmediate, instruction.func, srcA, 0x00, 0x00);
+	}
+
+	return false;
+}
+
+Disassembler::Disassembler() : instructions(opcodeCount * funcCount, nullptr), comparisons(opcodeCount * funcCount, nullptr), address{ 0 }
+{
+	// aliases follow their canonical mnemonic in the instruction set, so the first row of an encoding wins
+	for (const Instruction& instruction : instructionSet)
+	{
+		uint8_t opcode = static_cast<uint8_t>(instruction.opcode);
+		size_t index = opcode * funcCount + (instruction.func & getFuncMask(opcode));
+		std::vector<const Instruction*>& table = instruction.form == OPERAND_FORM::SRCA_SRCB ? comparisons : instructions;
+
+		if (!table.at(index))
+			table.at(index) = &instruction;
+	}
+}
+
+Disassembler::~Disassembler()
+{
+
+}
+
+void Disassembler::setSymbols(const std::vector<MapSymbol>& symbols)
+{
+	this->symbols = symbols;
+	std::stable_sort(this->symbols.begin(), this->symbols.end(), [](const MapSymbol& a, const MapSymbol& b) { return a.address < b.address; });
+}
+
+void Disassembler::load(const std::vector<uint32_t>& words, uint32_t address)
+{
+	this->words = words;
+	this->address = address;
+
+	labels.assign(words.size(), {});
+
+	for (const MapSymbol& symbol : symbols)
+	{
+		uint32_t pos = symbol.address - address;
+		if (pos < words.size())
+			labels.at(pos).push_back(&symbol);
+	}
+
+	// every word is decoded once, so traces only look up the text of their addresses
+	decoded.assign(words.size(), {});
+	sizes.assign(words.size(), 0);
+
+	for (size_t pos = 0; pos < words.size(); pos++)
+	{
+		size_t size = decode(pos, decoded.at(pos));
+
+		// a label cannot point to the immediate of an instruction
+		if (size == 2 && !labels.at(pos + 1).empty())
+			size = 0;
+
+		if (size == 0)
+		{
+			decoded.at(pos) = ".dw 0x";
+			appendHex(decoded.at(pos), words.at(pos), 8);
+		}
+
+		sizes.at(pos) = static_cast<uint8_t>(size);
+	}
+}
+
+size_t Disassembler::decode(size_t pos, std::string& text) const
+{
+	uint32_t word = words.at(pos);
+	uint8_t opcode = word >> 27;
+	bool fetchImmediate = (word >> 26) & 0x01;
+	uint8_t dst = word & 0x3F;
+	size_t index = opcode * funcCount + (((word >> 18) & 0xFF) & getFuncMask(opcode));
+
+	if (fetchImmediate && pos + 1 >= words.size())
+		return 0;
+
+	// a comparison is an arithmetic instruction which discards its result
+	const Instruction* instruction = comparisons.at(index);
+
+	if (!instruction || dst != 0x00 || !isEncodable(*instruction, word))
+		instruction = instructions.at(index);
+
+	if (!instruction || !isEncodable(*instruction, word))
+		return 0;
+
+	text = instruction->mnemonic;
+
+	if (!writeOperands(*instruction, word, fetchImmediate ? words.at(pos + 1) : 0, text))
+		return 0;
+
+	return fetchImmediate ? 2 : 1;
+}
+
+bool Disassembler::writeOperands(const Instruction& instruction, uint32_t word, uint32_t immediate, std::string& text) const
+{
+	bool fetchImmediate = (word >> 26) & 0x01;
+	uint8_t func = (word >> 18) & 0xFF;
+	uint8_t srcA = (word >> 12) & 0x3F;
+	uint8_t srcB = (word >> 6) & 0x3F;
+	uint8_t dst = word & 0x3F;
+
+	// second source, either a register or the immediate in the syntax of the instruction
+	auto writeSource = [&]()
+	{
+		text += ", ";
+
+		if (!fetchImmediate)
+			text += getRegisterName(srcB);
+		else if (instruction.immediate == IMMEDIATE_TYPE::FLOAT)
+			return appendFloat(text, immediate);
+		else
+			appendInt(text, immediate);
+
+		return true;
+	};
+
+	// the rounding mode is only written when it is not the default of the instruction
+	auto writeRoundingMode = [&]()
+	{
+		if ((func & 0xF0) != (instruction.func & 0xF0))
+			text += std::string(", ") + roundingModes[(func & 0xF0) >> 4];
+	};
+
+	switch (instruction.form)
+	{
+	case OPERAND_FORM::NONE:
+		break;
+
+	case OPERAND_FORM::DSTA_IMM:
+		text += ' ' + getRegisterName(dst) + ", 0x";
+		appendHex(text, immediate, 8);
+		break;
+
+	case OPERAND_FORM::SRCB_DSTA:
+		text += ' ' + getRegisterName(srcB) + ", " + getRegisterName(dst);
+		break;
+
+	case OPERAND_FORM::SRCB_ADDR:
+		text += ' ' + getRegisterName(srcB) + ", ";
+		writeAddress(srcA, fetchImmediate, immediate, text);
+		break;
+
+	case OPERAND_FORM::DSTA_ADDR:
+		text += ' ' + getRegisterName(dst) + ", ";
+		writeAddress(srcA, fetchImmediate, immediate, text);
+		break;
+
+	case OPERAND_FORM::SRCB:
+		text += ' ' + getRegisterName(srcB);
+		break;
+
+	case OPERAND_FORM::DSTA:
+		text += ' ' + getRegisterName(dst);
+		break;
+
+	case OPERAND_FORM::SRCA_SRCB_DSTA:
+		text += ' ' + getRegisterName(srcA);
+		writeSource();
+		if (dst != srcA)
+			text += ", " + getRegisterName(dst);
+		break;
+
+	case OPERAND_FORM::SRCA_SRCB_DSTA_DSTB:
+		text += ' ' + getRegisterName(srcA);
+		writeSource();
+		if (dst != srcA || (func >> 2) != 0x00)
+			text += ", " + getRegisterName(dst);
+		if ((func >> 2) != 0x00)
+			text += ", " + getRegisterName(func >> 2);
+		break;
+
+	case OPERAND_FORM::SRCA_DSTA:
+		text += ' ' + getRegisterName(srcA);
+		if (dst != srcA)
+			text += ", " + getRegisterName(dst);
+		break;
+
+	case OPERAND_FORM::SRCA_SRCB_DSTA_RM:
+		text += ' ' + getRegisterName(srcA);
+		if (!writeSource())
+			return false;
+		if (dst != srcA)
+			text += ", " + getRegisterName(dst);
+		writeRoundingMode();
+		break;
+
+	case OPERAND_FORM::SRCA_DSTA_RM:
+		text += ' ' + getRegisterName(srcA);
+		if (dst != srcA)
+			text += ", " + getRegisterName(dst);
+		writeRoundingMode();
+		break;
+
+	case OPERAND_FORM::SRCA_SRCB:
+		text += ' ' + getRegisterName(srcA);
+		return writeSource();
+
+	case OPERAND_FORM::ADDR:
+		text += ' ';
+
+		// direct jumps to a label of the image are written as label
+		if (fetchImmediate && srcA == 0x00 && isLabel(immediate))
+			text += labels.at(immediate - address).front()->name;
+		else
+			writeAddress(srcA, fetchImmediate, immediate, text);
+		break;
+	}
+
+	return true;
+}
+
+void Disassembler::writeAddress(uint8_t baseReg, bool fetchImmediate, uint32_t immediate, std::string& text) const
+{
+	text += '[';
+
+	if (baseReg != 0x00 || !fetchImmediate)
+		text += getRegisterName(baseReg);
+
+	if (fetchImmediate)
+	{
+		int32_t offset = static_cast<int32_t>(immediate);
+
+		if (baseReg == 0x00)
+		{
+			text += "0x";
+			appendHex(text, immediate, 8);
+		}
+		else if (offset < 0 && offset > -65536)
+			text += " - " + std::to_string(-offset);
+		else
+		{
+			text += " + ";
+			appendInt(text, immediate);
+		}
+	}
+
+	text += ']';
+}
+
+const MapSymbol* Disassembler::findSymbol(uint32_t address) const
+{
+	// last symbol at or before address
+	auto it = std::upper_bound(symbols.begin(), symbols.end(), address, [](uint32_t address, const MapSymbol& symbol) { return address < symbol.address; });
+	return it == symbols.begin() ? nullptr : &*(it - 1);
+}
+
+bool Disassembler::isLabel(uint32_t address) const
+{
+	uint32_t pos = address - this->address;
+	return pos < labels.size() && !labels.at(pos).empty();
+}
+
+void Disassembler::writeListing(std::string& text) const
+{
+	text += "; " + std::to_string(words.size()) + " words at 0x";
+	appendHex(text, address, 8);
+	text += "\n\t.org [0x";
+	appendHex(text, address, 8);
+	text += "]\n";
+
+	for (size_t pos = 0; pos < words.size();)
+	{
+		for (const MapSymbol* symbol : labels.at(pos))
+			text += symbol->name + ":\n";
+
+		// runs of equal words, like the padding up to the memory size, are repeated
+		size_t count = 1;
+
+		if (sizes.at(pos) < 2)
+		{
+			while (pos + count < words.size() && words.at(pos + count) == words.at(pos) && labels.at(pos + count).empty())
+				count++;
+		}
+
+		size_t lineBegin = text.size();
+		size_t size = std::max<size_t>(sizes.at(pos), 1);
+
+		if (count >= minRepeatLength)
+		{
+			text += "\t.rept " + std::to_string(count);
+			pad(text, lineBegin, instructionColumn);
+			text += "; ";
+			appendHex(text, address + static_cast<uint32_t>(pos), 8);
+			text += "\n\t" + decoded.at(pos) + "\n\t.endr\n";
+			pos += count;
+			continue;
+		}
+
+		text += '\t' + decoded.at(pos);
+		pad(text, lineBegin, instructionColumn);
+		text += "; ";
+		appendHex(text, address + static_cast<uint32_t>(pos), 8);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			text += ' ';
+			appendHex(text, words.at(pos + i), 8);
+		}
+
+		text += '\n';
+		pos += size;
+	}
+}
+
+void Disassembler::writeTrace(const std::vector<uint32_t>& trace, size_t begin, size_t end, std::string& text) const
+{
+	// address, symbol and offset if symbols are known, instruction
+	for (size_t i = begin; i < end; i++)
+	{
+		uint32_t pos = trace[i] - address;
+		size_t lineBegin = text.size();
+
+		appendHex(text, trace[i], 8);
+		text += "  ";
+
+		if (!symbols.empty())
+		{
+			const MapSymbol* symbol = pos < words.size() ? findSymbol(trace[i]) : nullptr;
+
+			if (symbol)
+			{
+				text += symbol->name;
+
+				if (trace[i] != symbol->address)
+					text += '+' + std::to_string(trace[i] - symbol->address);
+			}
+
+			pad(text, lineBegin + 10, locationColumn);
+			text += "  ";
+		}
+
+		text += pos < words.size() ? decoded[pos] : std::string("; outside of the image");
+		text += '\n';
+	}
+}
+
+void writeDisassembly(const Disassembler& disassembler, const std::vector<uint32_t>* trace, std::ostream& out)
+{
+	// the image is decoded by the disassembler already, text is written in batches
+	std::string text;
+
+	if (!trace)
+	{
+		disassembler.writeListing(text);
+		out.write(text.data(), text.size());
+		return;
+	}
+
+	for (size_t begin = 0; begin < trace->size(); begin += traceBatchSize)
+	{
+		text.clear();
+		disassembler.writeTrace(*trace, begin, std::min(trace->size(), begin + traceBatchSize), text);
+		out.write(text.data(), text.size());
+	}
+}
@@ -0,0 +1,34 @@
+#include "fileTable.h"
+
+FileTable fileTable;
+
+FileTable::FileTable()
+{
+
+}
+
+FileTable::~FileTable()
+{
+
+}
+
+uint32_t FileTable::getId(std::filesystem::path path)
+{
+	std::string key = path.lexically_normal().string();
+	std::lock_guard<std::mutex> lock{ mutex };
+
+	auto it = ids.find(key);
+	if (it != ids.end())
+		return it->second;
+
+	uint32_t id = static_cast<uint32_t>(paths.size());
+	paths.push_back(key);
+	ids.emplace(key, id);
+	return id;
+}
+
+const std::string& FileTable::getPath(uint32_t id)
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	return paths.at(id);
+}
@@ -0,0 +1,168 @@
+#include "isa.h"
+#include "converter.h"
+#include "parser.h"
+
+#include <unordered_map>
+#include <cctype>
+
+const std::vector<Instruction> instructionSet =
+{
+	{ "nop", INST::NOP, 0x00, OPERAND_FORM::NONE, IMMEDIATE_TYPE::INT },
+	{ "inr", INST::INR, 0x00, OPERAND_FORM::DSTA_IMM, IMMEDIATE_TYPE::WORD },
+	{ "mov", INST::MOV, 0x00, OPERAND_FORM::SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "stm", INST::STM, 0x00, OPERAND_FORM::SRCB_ADDR, IMMEDIATE_TYPE::INT },
+	{ "ldm", INST::LDM, 0x00, OPERAND_FORM::DSTA_ADDR, IMMEDIATE_TYPE::INT },
+	{ "push", INST::PUSH, 0x00, OPERAND_FORM::SRCB, IMMEDIATE_TYPE::INT },
+	{ "pop", INST::POP, 0x00, OPERAND_FORM::DSTA, IMMEDIATE_TYPE::INT },
+	{ "add", INST::ALU, static_cast<uint8_t>(ALU_FUNC::ADD), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "adc", INST::ALU, static_cast<uint8_t>(ALU_FUNC::ADC), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "sub", INST::ALU, static_cast<uint8_t>(ALU_FUNC::SUB), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "sbc", INST::ALU, static_cast<uint8_t>(ALU_FUNC::SBC), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "umul", INST::MUL, static_cast<uint8_t>(MUL_FUNC::UMUL), OPERAND_FORM::SRCA_SRCB_DSTA_DSTB, IMMEDIATE_TYPE::INT },
+	{ "smul", INST::MUL, static_cast<uint8_t>(MUL_FUNC::SMUL), OPERAND_FORM::SRCA_SRCB_DSTA_DSTB, IMMEDIATE_TYPE::INT },
+	{ "udiv", INST::DIV, static_cast<uint8_t>(DIV_FUNC::UDIV), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "sdiv", INST::DIV, static_cast<uint8_t>(DIV_FUNC::SDIV), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "umod", INST::DIV, static_cast<uint8_t>(DIV_FUNC::UMOD), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "smod", INST::DIV, static_cast<uint8_t>(DIV_FUNC::SMOD), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "inc", INST::ALU, static_cast<uint8_t>(ALU_FUNC::INC), OPERAND_FORM::SRCA_DSTA, IMMEDIATE_TYPE::INT },
+	{ "dec", INST::ALU, static_cast<uint8_t>(ALU_FUNC::DEC), OPERAND_FORM::SRCA_DSTA, IMMEDIATE_TYPE::INT },
+	{ "neg", INST::ALU, static_cast<uint8_t>(ALU_FUNC::NEG), OPERAND_FORM::SRCA_DSTA, IMMEDIATE_TYPE::INT },
+	{ "and", INST::ALU, static_cast<uint8_t>(ALU_FUNC::AND), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "or", INST::ALU, static_cast<uint8_t>(ALU_FUNC::OR), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "xor", INST::ALU, static_cast<uint8_t>(ALU_FUNC::XOR), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "not", INST::ALU, static_cast<uint8_t>(ALU_FUNC::NOT), OPERAND_FORM::SRCA_DSTA, IMMEDIATE_TYPE::INT },
+	{ "lsl", INST::ALU, static_cast<uint8_t>(ALU_FUNC::LSL), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "lsr", INST::ALU, static_cast<uint8_t>(ALU_FUNC::LSR), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "asr", INST::ALU, static_cast<uint8_t>(ALU_FUNC::ASR), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "ror", INST::ALU, static_cast<uint8_t>(ALU_FUNC::ROR), OPERAND_FORM::SRCA_SRCB_DSTA, IMMEDIATE_TYPE::INT },
+	{ "rrx", INST::ALU, static_cast<uint8_t>(ALU_FUNC::RRX), OPERAND_FORM::SRCA_DSTA, IMMEDIATE_TYPE::INT },
+	{ "fadd", INST::FPU, static_cast<uint8_t>(FPU_FUNC::ADD) | static_cast<uint8_t>(FPU_RM::RNE), OPERAND_FORM::SRCA_SRCB_DSTA_RM, IMMEDIATE_TYPE::FLOAT },
+	{ "fsub", INST::FPU, static_cast<uint8_t>(FPU_FUNC::SUB) | static_cast<uint8_t>(FPU_RM::RNE), OPERAND_FORM::SRCA_SRCB_DSTA_RM, IMMEDIATE_TYPE::FLOAT },
+	{ "fmul", INST::FPU, static_cast<uint8_t>(FPU_FUNC::MUL) | static_cast<uint8_t>(FPU_RM::RNE), OPERAND_FORM::SRCA_SRCB_DSTA_RM, IMMEDIATE_TYPE::FLOAT },
+	{ "fdiv", INST::FPU, static_cast<uint8_t>(FPU_FUNC::DIV) | static_cast<uint8_t>(FPU_RM::RNE), OPERAND_FORM::SRCA_SRCB_DSTA_RM, IMMEDIATE_TYPE::FLOAT },
+	{ "fsqrt", INST::FPU, static_cast<uint8_t>(FPU_FUNC::SQRT) | static_cast<uint8_t>(FPU_RM::RNE), OPERAND_FORM::SRCA_DSTA_RM, IMMEDIATE_TYPE::INT },
+	{ "fneg", INST::FPU, static_cast<uint8_t>(FPU_FUNC::NEG), OPERAND_FORM::SRCA_DSTA_RM, IMMEDIATE_TYPE::INT },
+	{ "fabs", INST::FPU, static_cast<uint8_t>(FPU_FUNC::ABS), OPERAND_FORM::SRCA_DSTA_RM, IMMEDIATE_TYPE::INT },
+	{ "cvtfi", INST::FPU, static_cast<uint8_t>(FPU_FUNC::CVTFI) | static_cast<uint8_t>(FPU_RM::RTZ), OPERAND_FORM::SRCA_DSTA_RM, IMMEDIATE_TYPE::INT },
+	{ "cvtfu", INST::FPU, static_cast<uint8_t>(FPU_FUNC::CVTFU) | static_cast<uint8_t>(FPU_RM::RTZ), OPERAND_FORM::SRCA_DSTA_RM, IMMEDIATE_TYPE::INT },
+	{ "cvtif", INST::FPU, static_cast<uint8_t>(FPU_FUNC::CVTIF) | static_cast<uint8_t>(FPU_RM::RNE), OPERAND_FORM::SRCA_DSTA_RM, IMMEDIATE_TYPE::INT },
+	{ "cvtuf", INST::FPU, static_cast<uint8_t>(FPU_FUNC::CVTUF) | static_cast<uint8_t>(FPU_RM::RNE), OPERAND_FORM::SRCA_DSTA_RM, IMMEDIATE_TYPE::INT },
+	{ "cmp", INST::ALU, static_cast<uint8_t>(ALU_FUNC::SUB), OPERAND_FORM::SRCA_SRCB, IMMEDIATE_TYPE::INT },
+	{ "cpc", INST::ALU, static_cast<uint8_t>(ALU_FUNC::SBC), OPERAND_FORM::SRCA_SRCB, IMMEDIATE_TYPE::INT },
+	{ "fcmp", INST::FPU, static_cast<uint8_t>(FPU_FUNC::CMP), OPERAND_FORM::SRCA_SRCB, IMMEDIATE_TYPE::FLOAT },
+	{ "jeq", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JEQ), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jzs", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JEQ), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jne", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JNE), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jzc", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JNE), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jhi", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JHI), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jsh", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JSH), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jcc", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JSH), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jsl", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JSL), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jlo", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JLO), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jcs", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JLO), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jgt", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JGT), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jge", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JGE), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jsc", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JGE), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jle", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JLE), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jlt", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JLT), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jss", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JLT), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jmi", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JMI), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jns", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JMI), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jpl", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JPL), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jnc", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JPL), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jvs", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JVS), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jvc", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JVC), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "jmp", INST::JMP, static_cast<uint8_t>(JMP_FUNC::JAL), OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "ien", INST::IEN, 0x00, OPERAND_FORM::NONE, IMMEDIATE_TYPE::INT },
+	{ "idi", INST::IDI, 0x00, OPERAND_FORM::NONE, IMMEDIATE_TYPE::INT },
+	{ "wait", INST::WAIT, 0x00, OPERAND_FORM::NONE, IMMEDIATE_TYPE::INT },
+	{ "reti", INST::RETI, 0x00, OPERAND_FORM::NONE, IMMEDIATE_TYPE::INT },
+	{ "call", INST::CALL, 0x00, OPERAND_FORM::ADDR, IMMEDIATE_TYPE::INT },
+	{ "ret", INST::RET, 0x00, OPERAND_FORM::NONE, IMMEDIATE_TYPE::INT }
+};
+
+const Instruction* findInstruction(const std::string& mnemonic)
+{
+	// mnemonics are looked up in lower and upper case only
+	static const std::unordered_map<std::string, const Instruction*> instructions = []()
+	{
+		std::unordered_map<std::string, const Instruction*> instructions;
+
+		for (const Instruction& instruction : instructionSet)
+		{
+			std::string upper = instruction.mnemonic;
+			for (char& c : upper)
+				c = std::toupper(static_cast<unsigned char>(c));
+
+			instructions.emplace(instruction.mnemonic, &instruction);
+			instructions.emplace(upper, &instruction);
+		}
+
+		return instructions;
+	}();
+
+	auto it = instructions.find(mnemonic);
+	return it != instructions.end() ? it->second : nullptr;
+}
+
+size_t getInstructionSize(const Instruction& instruction, const std::vector<std::string>& tokens)
+{
+	// size in words of the object code the compiler generates for tokens
+	// lines with an invalid number of operands or an invalid address generate no object code
+	std::string baseReg;
+	std::string offset;
+
+	switch (instruction.form)
+	{
+	case OPERAND_FORM::NONE:
+		return tokens.size() == 1 ? 1 : 0;
+
+	case OPERAND_FORM::DSTA_IMM:
+		return tokens.size() == 3 ? 2 : 0;
+
+	case OPERAND_FORM::SRCB_DSTA:
+		return tokens.size() == 3 ? 1 : 0;
+
+	case OPERAND_FORM::SRCB_ADDR:
+	case OPERAND_FORM::DSTA_ADDR:
+		if (tokens.size() != 3 || !parseAddress(tokens.at(2), baseReg, offset))
+			return 0;
+		return offset.empty() ? 1 : 2;
+
+	case OPERAND_FORM::SRCB:
+	case OPERAND_FORM::DSTA:
+		return tokens.size() == 2 ? 1 : 0;
+
+	case OPERAND_FORM::SRCA_SRCB_DSTA:
+		if (tokens.size() != 3 && tokens.size() != 4)
+			return 0;
+		return isRegister(tokens.at(2)) ? 1 : 2;
+
+	case OPERAND_FORM::SRCA_SRCB_DSTA_DSTB:
+	case OPERAND_FORM::SRCA_SRCB_DSTA_RM:
+		if (tokens.size() != 3 && tokens.size() != 4 && tokens.size() != 5)
+			return 0;
+		return isRegister(tokens.at(2)) ? 1 : 2;
+
+	case OPERAND_FORM::SRCA_DSTA:
+		return tokens.size() == 2 || tokens.size() == 3 ? 1 : 0;
+
+	case OPERAND_FORM::SRCA_DSTA_RM:
+		return tokens.size() >= 2 && tokens.size() <= 4 ? 1 : 0;
+
+	case OPERAND_FORM::SRCA_SRCB:
+		if (tokens.size() != 3)
+			return 0;
+		return isRegister(tokens.at(2)) ? 1 : 2;
+
+	case OPERAND_FORM::ADDR:
+		if (tokens.size() != 2)
+			return 0;
+		// labels always take an immediate
+		if (!parseAddress(tokens.at(1), baseReg, offset))
+			return 2;
+		return offset.empty() ? 1 : 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+#include "lineMap.h"
+#include "fileTable.h"
+#include "objectWriter.h"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+
+void writeLineMap(const ObjectCode& objectCode, bool text, std::ostream& out)
+{
+	const std::pmr::vector<LineEntry>& lines = objectCode.getLines();
+	uint32_t basePtr = objectCode.getBasePtr();
+
+	if (text)
+	{
+		out << "; address, source line of the words up to the next address, - for gaps and padding" << '\n';
+
+		for (const LineEntry& line : lines)
+		{
+			writeHex(out, basePtr + static_cast<uint32_t>(line.pos), 8);
+
+			if (line.fileId == noFileId)
+				out << " -" << '\n';
+			else
+				out << ' ' << fileTable.getPath(line.fileId) << ':' << std::dec << line.lineNumber << '\n';
+		}
+
+		return;
+	}
+
+	// files are numbered in order of their first entry
+	std::unordered_map<uint32_t, uint32_t> fileIndices;
+	std::vector<uint32_t> fileIds;
+
+	for (const LineEntry& line : lines)
+	{
+		if (line.fileId != noFileId && fileIndices.emplace(line.fileId, static_cast<uint32_t>(fileIds.size())).second)
+			fileIds.push_back(line.fileId);
+	}
+
+	auto writeU32 = [&](uint32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(uint32_t)); };
+
+	writeU32(lineMapMagic);
+	writeU32(static_cast<uint32_t>(fileIds.size()));
+	writeU32(static_cast<uint32_t>(lines.size()));
+
+	for (uint32_t fileId : fileIds)
+	{
+		const std::string& path = fileTable.getPath(fileId);
+		writeU32(static_cast<uint32_t>(path.size()));
+		out.write(path.data(), path.size());
+	}
+
+	for (const LineEntry& line : lines)
+	{
+		writeU32(basePtr + static_cast<uint32_t>(line.pos));
+		writeU32(line.fileId == noFileId ? noFileId : fileIndices.at(line.fileId));
+		writeU32(line.lineNumber);
+	}
+}
+
+bool LineMap::read(std::string path)
+{
+	std::ifstream file(path, std::ios::binary);
+	uint32_t header[3];
+
+	files.clear();
+	entries.clear();
+
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != lineMapMagic)
+		return false;
+
+	files.resize(header[1]);
+
+	for (std::string& name : files)
+	{
+		uint32_t length;
+		if (!file.read(reinterpret_cast<char*>(&length), sizeof(uint32_t)))
+			return false;
+
+		name.resize(length);
+		if (!file.read(&name[0], length))
+			return false;
+	}
+
+	entries.resize(header[2]);
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(LineMapEntry)));
+}
+
+const LineMapEntry* LineMap::find(uint32_t address) const
+{
+	// last entry which starts at or before address
+	auto it = std::upper_bound(entries.begin(), entries.end(), address, [](uint32_t address, const LineMapEntry& entry) { return address < entry.address; });
+
+	if (it == entries.begin() || (it - 1)->file == noFileId)
+		return nullptr;
+
+	return &*(it - 1);
+}
@@ -0,0 +1,132 @@
+#include "macro.h"
+
+// placeholder for the unique expansion id '\@'
+const int uniqueId = -2;
+// literal text without placeholder
+const int noParam = -1;
+
+Macro::Macro(std::string name, std::vector<std::string> params) : name{ name }, params{ params }
+{
+
+}
+
+Macro::~Macro()
+{
+
+}
+
+std::string Macro::getName()
+{
+	return name;
+}
+
+size_t Macro::getParamCount()
+{
+	return params.size();
+}
+
+size_t Macro::getLineCount()
+{
+	return lineEnds.size();
+}
+
+bool Macro::getParamIndex(std::string param, size_t& index)
+{
+	for (index = 0; index < params.size(); index++)
+	{
+		if (params.at(index) == param)
+			return true;
+	}
+
+	return false;
+}
+
+void Macro::addLine(std::vector<std::string>& tokens)
+{
+	for (std::string& token : tokens)
+	{
+		std::string text;
+		char strDelimiter = '\0';
+		size_t i = 0;
+
+		while (i < token.size())
+		{
+			char c = token.at(i);
+
+			// no substitution inside of string and char literals
+			if (strDelimiter != '\0')
+			{
+				if (c == '\\' && i + 1 < token.size())
+				{
+					text += token.substr(i, 2);
+					i += 2;
+					continue;
+				}
+				if (c == strDelimiter)
+					strDelimiter = '\0';
+			}
+			else if (c == '\"' || c == '\'')
+				strDelimiter = c;
+
+			else if (c == '\\' && i + 1 < token.size())
+			{
+				if (token.at(i + 1) == '@')
+				{
+					parts.push_back(TokenPart{ text, uniqueId });
+					text.clear();
+					i += 2;
+					continue;
+				}
+
+				size_t end = token.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_", i + 1);
+				if (end == std::string::npos)
+					end = token.size();
+
+				size_t index;
+				if (end > i + 1 && getParamIndex(token.substr(i + 1, end - i - 1), index))
+				{
+					parts.push_back(TokenPart{ text, static_cast<int>(index) });
+					text.clear();
+					i = end;
+					continue;
+				}
+			}
+
+			text += c;
+			i++;
+		}
+
+		parts.push_back(TokenPart{ text, noParam });
+		tokenEnds.push_back(parts.size());
+	}
+
+	lineEnds.push_back(tokenEnds.size());
+}
+
+void Macro::expandLine(size_t index, std::vector<std::string>& args, unsigned int id, std::vector<std::string>& tokens)
+{
+	size_t firstToken = index == 0 ? 0 : lineEnds.at(index - 1);
+	size_t lastToken = lineEnds.at(index);
+
+	tokens.resize(lastToken - firstToken);
+
+	for (size_t i = firstToken; i < lastToken; i++)
+	{
+		size_t firstPart = i == 0 ? 0 : tokenEnds.at(i - 1);
+		size_t lastPart = tokenEnds.at(i);
+		std::string& token = tokens.at(i - firstToken);
+
+		token.clear();
+
+		for (size_t j = firstPart; j < lastPart; j++)
+		{
+			TokenPart& part = parts.at(j);
+			token += part.text;
+
+			if (part.param == uniqueId)
+				token += std::to_string(id);
+			else if (part.param != noParam)
+				token += args.at(part.param);
+		}
+	}
+}
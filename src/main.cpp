@@ -1,83 +1,673 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <sstream>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 #include "compiler.h"
+#include "variant.h"
+#include "watch.h"
+#include "memoryReport.h"
+#include "compressor.h"
+#include "delta.h"
+#include "lineMap.h"
+#include "mapFile.h"
+#include "profiler.h"
+#include "disassembler.h"
 
-int main(int argC, char* argV[])
+struct ExportSettings
 {
-	std::string srcPath;
-	std::string dstPath;
-	std::string option = "-raw"; // default option
+	std::vector<std::string> formats;
+	bool writeIfChanged = false;
+	unsigned int bramWidth = 0;
+	size_t bramDepth = 0;
+	bool stub = false;
+	uint32_t stubOrg = 0;
+	std::string previousPath;
+};
 
-	Compiler compiler;
+// splits the object code into one .mem file per block ram, named <destination>_<depth index>_<width index>
+static bool exportBram(const ObjectCode& objectCode, std::string dstPath, const ExportSettings& settings, std::ostream& log)
+{
+	bool success = true;
 
-	// process input arguments
-	// no arguments
-	if (argC == 1)
+	for (size_t begin = 0, row = 0; begin < objectCode.size(); begin += settings.bramDepth, row++)
 	{
-		std::cout << "Fatal: no source file specified!" << std::endl;
-		return -1;
+		for (unsigned int shift = 0, column = 0; shift < 32; shift += settings.bramWidth, column++)
+		{
+			MemWriter writer{ settings.bramWidth, shift, begin, settings.bramDepth };
+			writer.setLog(log);
+			writer.setWriteIfChanged(settings.writeIfChanged);
+			success = objectCode.exportTo(writer, dstPath + "_" + std::to_string(row) + "_" + std::to_string(column)) && success;
+		}
 	}
-	// source Path only
-	else if (argC == 2)
+
+	return success;
+}
+
+// run length encoded object code, optionally behind a decompressor which unpacks it at boot
+static bool exportCompressed(const ObjectCode& objectCode, std::string dstPath, const ExportSettings& settings, std::ostream& log)
+{
+	std::vector<uint32_t> image;
+
+	if (settings.stub)
 	{
-		srcPath = argV[1];
-		dstPath = srcPath.substr(0, srcPath.find_last_of('.'));
+		if (!buildBootImage(objectCode.getData(), objectCode.getBasePtr(), settings.stubOrg, image, log))
+			return false;
+	}
+	else
+		image = compressRle(objectCode.getData(), objectCode.getBasePtr());
+
+	log << "Compressed " << objectCode.size() << " words to " << image.size() << " words." << std::endl;
+
+	std::unique_ptr<ObjectWriter> writer = createObjectWriter("-rle");
+	writer->setLog(log);
+	writer->setWriteIfChanged(settings.writeIfChanged);
+
+	if (!writer->open(dstPath))
+		return false;
+
+	writer->write(image);
+	return writer->close(true);
+}
+
+// only the words which changed since the previous image
+static bool exportDelta(const ObjectCode& objectCode, std::string dstPath, const std::vector<uint32_t>& previous, const ExportSettings& settings, std::ostream& log)
+{
+	std::vector<uint32_t> delta = buildDelta(previous, objectCode.getData(), objectCode.getBasePtr());
+	log << "Delta of " << delta.at(2) << " range(s) takes " << delta.size() << " words." << std::endl;
+
+	std::unique_ptr<ObjectWriter> writer = createObjectWriter("-delta");
+	writer->setLog(log);
+	writer->setWriteIfChanged(settings.writeIfChanged);
+
+	if (!writer->open(dstPath))
+		return false;
+
+	writer->write(delta);
+	return writer->close(true);
+}
+
+static bool exportFormat(const ObjectCode& objectCode, std::string dstPath, std::string format, const std::vector<uint32_t>& previous, const ExportSettings& settings, std::ostream& log)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::EXPORT };
+
+	if (format == "-mem" && settings.bramDepth > 0)
+		return exportBram(objectCode, dstPath, settings, log);
+
+	if (format == "-rle")
+		return exportCompressed(objectCode, dstPath, settings, log);
+
+	if (format == "-delta")
+		return exportDelta(objectCode, dstPath, previous, settings, log);
+
+	if (format == "-map")
+		return writeReport(dstPath, ".map", false, settings.writeIfChanged, log, [&](std::ostream& out) { writeMap(objectCode, out); });
+
+	if (format == "-lines" || format == "-lines-txt")
+	{
+		bool text = format == "-lines-txt";
+		return writeReport(dstPath, text ? ".lines.txt" : ".lines", !text, settings.writeIfChanged, log, [&](std::ostream& out) { writeLineMap(objectCode, text, out); });
+	}
+
+	std::unique_ptr<ObjectWriter> writer = createObjectWriter(format);
+	writer->setLog(log);
+	writer->setWriteIfChanged(settings.writeIfChanged);
+	return objectCode.exportTo(*writer, dstPath);
+}
+
+// every format is written by its own thread, the object code is only read while exporting
+static bool exportObjectCode(const ObjectCode& objectCode, std::string dstPath, const ExportSettings& settings, std::ostream& log)
+{
+	std::vector<uint32_t> previous;
+
+	// read before any export, the previous image might be replaced by this build
+	if (!settings.previousPath.empty() && !readImage(settings.previousPath, previous))
+	{
+		log << "Fatal: cannot read previous image '" << settings.previousPath << "'!" << std::endl;
+		return false;
+	}
+
+	if (settings.formats.size() == 1)
+		return exportFormat(objectCode, dstPath, settings.formats.front(), previous, settings, log);
+
+	std::vector<std::ostringstream> logs(settings.formats.size());
+	std::vector<char> results(settings.formats.size());
+	std::vector<std::thread> threads;
+
+	for (size_t i = 0; i < settings.formats.size(); i++)
+		threads.emplace_back([&, i]() { results[i] = exportFormat(objectCode, dstPath, settings.formats[i], previous, settings, logs[i]); });
+
+	bool success = true;
+
+	// logs are printed in the order of the formats
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+		log << logs[i].str();
+		success = results[i] && success;
+	}
+
+	return success;
+}
+
+// samples per routine and per line, annotated source and folded stacks of a program counter trace
+static bool profileTrace(const ObjectCode& objectCode, std::string dstPath, std::string tracePath, const ExportSettings& settings, std::ostream& log)
+{
+	std::vector<uint32_t> trace;
+
+	if (!readImage(tracePath, trace))
+	{
+		log << "Fatal: cannot read trace '" << tracePath << "'!" << std::endl;
+		return false;
+	}
+
+	Profile profile;
+	profile.build(objectCode, trace);
+	log << "Profiled " << profile.total << " samples, " << profile.outside << " outside of the object code." << std::endl;
+
+	bool success = true;
+
+	for (PROFILE_OUTPUT output : { PROFILE_OUTPUT::REPORT, PROFILE_OUTPUT::ANNOTATED, PROFILE_OUTPUT::FOLDED })
+	{
+		success = writeReport(dstPath, getProfileExtension(output), false, settings.writeIfChanged, log, [&](std::ostream& out) { writeProfile(objectCode, profile, output, out); }) && success;
+	}
+
+	return success;
+}
+
+// listing of a raw image, or of the instructions a program counter trace went through
+static bool disassembleImage(std::string imagePath, std::string dstPath, uint32_t address, std::string symbolPath, std::string tracePath, const ExportSettings& settings, std::ostream& log)
+{
+	std::vector<uint32_t> image;
+	std::vector<uint32_t> trace;
+	std::vector<MapSymbol> symbols;
+
+	if (!readImage(imagePath, image))
+	{
+		log << "Fatal: cannot read image '" << imagePath << "'!" << std::endl;
+		return false;
+	}
+	if (!symbolPath.empty() && !readMap(symbolPath, symbols))
+	{
+		log << "Fatal: cannot read map '" << symbolPath << "'!" << std::endl;
+		return false;
+	}
+	if (!tracePath.empty() && !readImage(tracePath, trace))
+	{
+		log << "Fatal: cannot read trace '" << tracePath << "'!" << std::endl;
+		return false;
 	}
-	// source path + destination path / option
-	else if (argC == 3)
+
+	Disassembler disassembler;
+	disassembler.setSymbols(symbols);
+	disassembler.load(image, address);
+
+	const std::vector<uint32_t>* samples = tracePath.empty() ? nullptr : &trace;
+	return writeReport(dstPath, samples ? ".trace.txt" : ".dis", false, settings.writeIfChanged, log, [&](std::ostream& out) { writeDisassembly(disassembler, samples, out); });
+}
+
+// parses <width>x<depth>, the width has to divide the word size
+static bool parseBram(std::string arg, ExportSettings& settings)
+{
+	size_t separator = arg.find('x');
+
+	if (separator == std::string::npos)
+		return false;
+
+	try
+	{
+		size_t end;
+		unsigned long width = std::stoul(arg.substr(0, separator), &end);
+
+		if (end != separator)
+			return false;
+
+		std::string depth = arg.substr(separator + 1);
+		settings.bramDepth = std::stoul(depth, &end);
+
+		if (end != depth.size())
+			return false;
+
+		settings.bramWidth = static_cast<unsigned int>(width);
+	}
+	catch (std::exception&) { return false; }
+
+	return settings.bramWidth > 0 && settings.bramWidth <= 32 && 32 % settings.bramWidth == 0 && settings.bramDepth > 0;
+}
+
+int main(int argC, char* argV[])
+{
+	std::string srcPath;
+	std::string dstPath;
+	std::string matrixPath;
+	std::string tracePath;
+	std::string symbolPath;
+	std::string disassemblyTracePath;
+	uint32_t imageAddress = defaultBasePtr;
+	bool disassemble = false;
+	ExportSettings settings;
+	bool watchMode = false;
+	bool precompiled = false;
+	bool pipelined = false;
+	bool parallel = false;
+	unsigned int threads = 0;
+	bool memoryReport = false;
+	bool stream = false;
+	std::vector<std::pair<std::string, std::string>> defines;
+	std::vector<std::string> includePaths;
+
+	// process input arguments
+	// a source path of "-" is standard input, a destination path of "-" is standard output
+	// [source path] [destination path] [format]... [-bram widthxdepth] [-stub org] [-delta previous path] [-profile trace path] [-D identifier[=value]]... [-I include path]... [-matrix matrix path] [--watch] [-pch] [-pipeline] [-parallel] [-threads count] [--mem-report] [-stream] [--if-changed]
+	// the source of -disasm is a raw image: [image path] [destination path] -disasm [-base address] [-symbols map path] [-trace trace path]
+	for (int i = 1; i < argC; i++)
 	{
-		srcPath = argV[1];
-		// 2nd argument is option
-		if (argV[2][0] == '-')
+		std::string arg = argV[i];
+
+		// any combination of formats can be exported at once, line maps included
+		if (arg == "-raw" || arg == "-mif" || arg == "-coe" || arg == "-mem" || arg == "-rle" || arg == "-lines" || arg == "-lines-txt" || arg == "-map")
+		{
+			if (std::find(settings.formats.begin(), settings.formats.end(), arg) == settings.formats.end())
+				settings.formats.push_back(arg);
+		}
+
+		// split .mem output into block rams of the given width and depth
+		else if (arg == "-bram")
+		{
+			if (i + 1 >= argC || !parseBram(argV[++i], settings))
+			{
+				std::cout << "Fatal: invalid block ram size, expected <width>x<depth>!" << std::endl;
+				return -1;
+			}
+		}
+
+		// prepend a decompressor at the given address to .rle output
+		else if (arg == "-stub")
+		{
+			bool valid = i + 1 < argC;
+
+			if (valid)
+				settings.stubOrg = toInt(argV[++i], [&](std::string) { valid = false; });
+
+			if (!valid)
+			{
+				std::cout << "Fatal: invalid decompressor address!" << std::endl;
+				return -1;
+			}
+
+			settings.stub = true;
+		}
+
+		// changed ranges against a previous raw image
+		else if (arg == "-delta")
+		{
+			if (i + 1 >= argC)
+			{
+				std::cout << "Fatal: no previous image specified!" << std::endl;
+				return -1;
+			}
+
+			settings.previousPath = argV[++i];
+
+			if (std::find(settings.formats.begin(), settings.formats.end(), arg) == settings.formats.end())
+				settings.formats.push_back(arg);
+		}
+
+		// profile of a program counter trace recorded by the debug core
+		else if (arg == "-profile")
+		{
+			if (i + 1 >= argC)
+			{
+				std::cout << "Fatal: no trace specified!" << std::endl;
+				return -1;
+			}
+
+			tracePath = argV[++i];
+		}
+
+		// list the instructions of a raw image instead of compiling
+		else if (arg == "-disasm")
+			disassemble = true;
+
+		// address of the first word of the image
+		else if (arg == "-base")
 		{
-			if (std::string(argV[2]) == "-raw" || std::string(argV[2]) == "-mif" || std::string(argV[2]) == "-coe")
+			bool valid = i + 1 < argC;
+
+			if (valid)
+				imageAddress = toInt(argV[++i], [&](std::string) { valid = false; });
+
+			if (!valid)
 			{
-				dstPath = srcPath.substr(0, srcPath.find_last_of('.'));
-				option = argV[2];
+				std::cout << "Fatal: invalid base address!" << std::endl;
+				return -1;
 			}
-			else
+		}
+
+		// labels of the image from a map file
+		else if (arg == "-symbols")
+		{
+			if (i + 1 >= argC)
 			{
-				std::cout << "Fatal: invalid option '" << argV[2] << "'!" << std::endl;
+				std::cout << "Fatal: no map file specified!" << std::endl;
 				return -1;
 			}
+
+			symbolPath = argV[++i];
 		}
-		// 2nd argument is destination path
+
+		// list the instruction of every sample of a trace instead of the image
+		else if (arg == "-trace")
+		{
+			if (i + 1 >= argC)
+			{
+				std::cout << "Fatal: no trace specified!" << std::endl;
+				return -1;
+			}
+
+			disassemblyTracePath = argV[++i];
+		}
+
+		else if (arg.substr(0, 2) == "-D")
+		{
+			std::pair<std::string, std::string> define;
+
+			if (arg.size() == 2 && i + 1 < argC)
+				arg += argV[++i];
+
+			if (!parseDefine(arg.substr(2), define))
+			{
+				std::cout << "Fatal: invalid define '" << arg << "'!" << std::endl;
+				return -1;
+			}
+
+			defines.push_back(define);
+		}
+		// directories searched for included files
+		else if (arg.substr(0, 2) == "-I")
+		{
+			if (arg.size() == 2 && i + 1 < argC)
+				arg += argV[++i];
+
+			if (arg.size() == 2)
+			{
+				std::cout << "Fatal: no include path specified!" << std::endl;
+				return -1;
+			}
+
+			includePaths.push_back(arg.substr(2));
+		}
+		// build one variant per line of the matrix file
+		else if (arg == "-matrix")
+		{
+			if (i + 1 >= argC)
+			{
+				std::cout << "Fatal: no matrix file specified!" << std::endl;
+				return -1;
+			}
+
+			matrixPath = argV[++i];
+		}
+		// rebuild whenever a source file changes
+		else if (arg == "--watch")
+			watchMode = true;
+
+		// load and store precompiled source files
+		else if (arg == "-pch")
+			precompiled = true;
+
+		// read, parse and compile on separate threads
+		else if (arg == "-pipeline")
+			pipelined = true;
+
+		// size instructions first and encode them on all cores
+		else if (arg == "-parallel")
+			parallel = true;
+
+		// number of encoder threads instead of one per core
+		else if (arg == "-threads")
+		{
+			bool valid = i + 1 < argC;
+
+			if (valid)
+				threads = toInt(argV[++i], [&](std::string) { valid = false; });
+
+			if (!valid || threads == 0)
+			{
+				std::cout << "Fatal: invalid thread count!" << std::endl;
+				return -1;
+			}
+		}
+
+		// count allocations of each stage and report the largest containers
+		else if (arg == "--mem-report")
+			memoryReport = true;
+
+		// write object code to the destination while compiling
+		else if (arg == "-stream")
+			stream = true;
+
+		// keep outputs whose content did not change
+		else if (arg == "--if-changed")
+			settings.writeIfChanged = true;
+
+		else if (arg.size() > 1 && arg.front() == '-')
+		{
+			std::cout << "Fatal: invalid option '" << arg << "'!" << std::endl;
+			return -1;
+		}
+		else if (srcPath.empty())
+			srcPath = arg;
+
+		else if (dstPath.empty())
+			dstPath = arg;
+
+		// too many arguments
 		else
-			dstPath = argV[2];
+		{
+			std::cout << "Fatal: invalid number of arguments!" << std::endl;
+			return -1;
+		}
 	}
-	// source path + destination path + option
-	else if (argC == 4)
+
+	// no source file
+	if (srcPath.empty())
 	{
-		srcPath = argV[1];
-		dstPath = argV[2];
+		std::cout << "Fatal: no source file specified!" << std::endl;
+		return -1;
+	}
 
-		if (std::string(argV[3]) == "-raw" || std::string(argV[3]) == "-mif" || std::string(argV[3]) == "-coe")
-			option = argV[3];
-		else
+	if (disassemble)
+	{
+		if (srcPath == "-" || !settings.formats.empty() || !matrixPath.empty() || !tracePath.empty() || watchMode || stream)
 		{
-			std::cout << "Fatal: invalid option '" << argV[2] << "'!" << std::endl;
+			std::cout << "Fatal: disassembling takes an image file and cannot be combined with formats, profiling, watch, matrix or streaming mode!" << std::endl;
 			return -1;
 		}
+
+		if (dstPath.empty())
+			dstPath = srcPath.substr(0, srcPath.find_last_of('.'));
+
+		std::ostream& log = dstPath == "-" ? std::cerr : std::cout;
+		return disassembleImage(srcPath, dstPath, imageAddress, symbolPath, disassemblyTracePath, settings, log) ? 0 : -1;
 	}
-	// too many arguments
-	else
+
+	if (imageAddress != defaultBasePtr || !symbolPath.empty() || !disassemblyTracePath.empty())
 	{
-		std::cout << "Fatal: invalid number of arguments!" << std::endl;
+		std::cout << "Fatal: -base, -symbols and -trace require -disasm!" << std::endl;
 		return -1;
 	}
 
-	if (compiler.compileSource(srcPath))
+	// standard input can only be read once
+	if (srcPath == "-" && (watchMode || !matrixPath.empty()))
 	{
-		if (option == "-mif")
-			return compiler.objectCode.exportMif(dstPath) ? 0 : -1;
+		std::cout << "Fatal: standard input cannot be combined with watch or matrix mode!" << std::endl;
+		return -1;
+	}
 
-		if (option == "-coe")
-			return compiler.objectCode.exportCoe(dstPath) ? 0 : -1;
+	if (memoryReport)
+	{
+		if (watchMode)
+		{
+			std::cout << "Fatal: memory report cannot be combined with watch mode!" << std::endl;
+			return -1;
+		}
 
-		else
-			return compiler.objectCode.exportRaw(dstPath) ? 0 : -1;
+		enableMemoryReport();
+	}
+
+	if (threads > 0 && !parallel)
+	{
+		std::cout << "Fatal: -threads requires -parallel!" << std::endl;
+		return -1;
 	}
 
-	return -1;
+	if (stream && (watchMode || !matrixPath.empty() || pipelined || parallel))
+	{
+		std::cout << "Fatal: streaming cannot be combined with watch, matrix, pipeline or parallel mode!" << std::endl;
+		return -1;
+	}
+
+	if (settings.formats.empty())
+		settings.formats.push_back("-raw"); // default format
+
+	// formats which are written in one piece
+	bool recordFormat = std::any_of(settings.formats.begin(), settings.formats.end(), [](const std::string& format) { return format == "-mem" || format == "-rle" || format == "-delta" || format == "-lines" || format == "-lines-txt" || format == "-map"; });
+
+	bool memFormat = std::find(settings.formats.begin(), settings.formats.end(), "-mem") != settings.formats.end();
+
+	if (settings.bramDepth > 0 && !memFormat)
+	{
+		std::cout << "Fatal: block ram splitting requires -mem!" << std::endl;
+		return -1;
+	}
+
+	bool rleFormat = std::find(settings.formats.begin(), settings.formats.end(), "-rle") != settings.formats.end();
+
+	if (settings.stub && !rleFormat)
+	{
+		std::cout << "Fatal: decompressor requires -rle!" << std::endl;
+		return -1;
+	}
+
+	// records of .mem, .rle, .dlt, line map and map files have no fixed size and cannot be patched
+	if (stream && (recordFormat || settings.formats.size() > 1))
+	{
+		std::cout << "Fatal: streaming requires exactly one of -raw, -mif or -coe!" << std::endl;
+		return -1;
+	}
+
+	// the profile needs the complete object code and files of its own
+	if (!tracePath.empty() && (stream || watchMode || !matrixPath.empty()))
+	{
+		std::cout << "Fatal: profiling cannot be combined with streaming, watch or matrix mode!" << std::endl;
+		return -1;
+	}
+
+	if (!matrixPath.empty())
+	{
+		if (watchMode)
+		{
+			std::cout << "Fatal: matrix mode cannot be combined with watch mode!" << std::endl;
+			return -1;
+		}
+
+		std::vector<Variant> variants;
+
+		if (!dstPath.empty())
+		{
+			std::cout << "Fatal: destination paths are given by the matrix file!" << std::endl;
+			return -1;
+		}
+		if (!readVariants(matrixPath, variants))
+			return -1;
+
+		bool success = compileVariants(srcPath, defines, variants, precompiled, pipelined, parallel, threads, includePaths, std::bind(exportObjectCode, std::placeholders::_1, std::placeholders::_2, std::cref(settings), std::placeholders::_3));
+
+		// containers of the variants are gone already
+		if (memoryReport)
+			printMemoryReport(std::cout, {});
+
+		return success ? 0 : -1;
+	}
+
+	// destination path defaults to source path without extension, standard input to standard output
+	if (dstPath.empty())
+		dstPath = srcPath.substr(0, srcPath.find_last_of('.'));
+
+	if (dstPath == "-")
+	{
+		if (settings.formats.size() > 1 || settings.bramDepth > 0 || settings.writeIfChanged || watchMode || !tracePath.empty())
+		{
+			std::cout << "Fatal: standard output takes exactly one format and cannot be combined with watch mode or profiling!" << std::endl;
+			return -1;
+		}
+
+#ifdef _WIN32
+		// raw object code must not be translated
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	}
+
+	// messages must not mix with object code on standard output
+	std::ostream& log = dstPath == "-" ? std::cerr : std::cout;
+
+	// constructed after the memory report is enabled, so its allocations are counted
+	Compiler compiler;
+
+	for (std::pair<std::string, std::string>& define : defines)
+		compiler.addDefine(define.first, define.second);
+
+	compiler.setLog(log);
+	compiler.setIncludePaths(includePaths);
+	compiler.setPipelined(pipelined);
+	compiler.setParallel(parallel, threads);
+
+	if (watchMode)
+	{
+		SourceCache cache;
+		cache.setPrecompiled(precompiled);
+		compiler.setSourceCache(&cache);
+
+		bool success = watch(cache, [&]() { return compiler.compileSource(srcPath) && exportObjectCode(compiler.objectCode, dstPath, settings, std::cout); });
+		return success ? 0 : -1;
+	}
+
+	compiler.setPrecompiled(precompiled);
+	bool success;
+
+	if (stream)
+	{
+		// only words with unresolved references are patched after compiling
+		std::unique_ptr<ObjectWriter> writer = createObjectWriter(settings.formats.front());
+		writer->setLog(log);
+		writer->setWriteIfChanged(settings.writeIfChanged);
+
+		if (!writer->open(dstPath))
+			return -1;
+
+		compiler.objectCode.setWriter(writer.get());
+		success = compiler.compileSource(srcPath);
+		success = writer->close(success) && success;
+		compiler.objectCode.setWriter(nullptr);
+	}
+	else
+		success = compiler.compileSource(srcPath) && exportObjectCode(compiler.objectCode, dstPath, settings, log);
+
+	if (success && !tracePath.empty())
+		success = profileTrace(compiler.objectCode, dstPath, tracePath, settings, log);
+
+	if (memoryReport)
+		printMemoryReport(log, compiler.getMemoryUsage());
+
+	return success ? 0 : -1;
 }
\ No newline at end of file
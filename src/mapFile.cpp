@@ -0,0 +1,137 @@
+#include "mapFile.h"
+#include "constants.h"
+#include "fileTable.h"
+#include "objectWriter.h"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_set>
+
+std::vector<MapSymbol> collectSymbols(const ObjectCode& objectCode)
+{
+	std::vector<MapSymbol> symbols;
+	std::unordered_set<std::string> names;
+
+	for (const Dereference& dereference : objectCode.getDereferences())
+	{
+		if (names.emplace(dereference.identifier).second)
+			symbols.push_back({ std::string(dereference.identifier), dereference.address, 0, dereference.fileId, dereference.lineNumber });
+	}
+
+	std::stable_sort(symbols.begin(), symbols.end(), [](const MapSymbol& a, const MapSymbol& b) { return a.address < b.address; });
+
+	// a symbol ends at the next symbol or at the end of the segment it starts in
+	const std::pmr::vector<Segment>& segments = objectCode.getSegments();
+	uint32_t basePtr = objectCode.getBasePtr();
+	size_t segment = 0;
+
+	for (size_t i = 0; i < symbols.size(); i++)
+	{
+		// labels in front of the first .org
+		if (symbols.at(i).address < basePtr)
+			continue;
+
+		size_t pos = symbols.at(i).address - basePtr;
+
+		while (segment + 1 < segments.size() && segments.at(segment + 1).begin <= pos)
+			segment++;
+
+		size_t end = segment < segments.size() ? std::max(segments.at(segment).end, pos) : pos;
+
+		if (i + 1 < symbols.size())
+			end = std::min<size_t>(end, symbols.at(i + 1).address - basePtr);
+
+		symbols.at(i).size = end - pos;
+	}
+
+	return symbols;
+}
+
+bool readMap(std::string path, std::vector<MapSymbol>& symbols)
+{
+	std::ifstream file(path);
+	std::string line;
+
+	symbols.clear();
+
+	if (!file.is_open())
+		return false;
+
+	while (std::getline(file, line) && line != "Symbols by address");
+
+	// skip the column titles
+	if (!std::getline(file, line))
+		return false;
+
+	// <address> <words> <name>, <path>:<line number> up to the blank line after the section
+	while (std::getline(file, line) && !line.empty() && line != "\r")
+	{
+		size_t nameBegin = line.find_first_not_of(' ', line.find_first_of(' ', line.find(' ') + 1));
+		size_t nameEnd = line.find(", ", nameBegin);
+		size_t lineNumberBegin = line.find_last_of(':');
+
+		if (nameBegin == std::string::npos || nameEnd == std::string::npos || lineNumberBegin == std::string::npos)
+			return false;
+
+		try
+		{
+			MapSymbol symbol;
+			symbol.address = static_cast<uint32_t>(std::stoul(line.substr(0, 8), nullptr, 16));
+			symbol.size = std::stoul(line.substr(9));
+			symbol.name = line.substr(nameBegin, nameEnd - nameBegin);
+			symbol.fileId = noFileId;
+			symbol.lineNumber = static_cast<unsigned int>(std::stoul(line.substr(lineNumberBegin + 1)));
+			symbols.push_back(symbol);
+		}
+		catch (std::exception&) { return false; }
+	}
+
+	return !symbols.empty() || file.good();
+}
+
+static void writeSymbol(const MapSymbol& symbol, std::ostream& out)
+{
+	writeHex(out, symbol.address, 8);
+	out << ' ' << std::dec << std::setw(8) << std::setfill(' ') << std::left << symbol.size << std::right << ' ' << symbol.name;
+	out << ", " << fileTable.getPath(symbol.fileId) << ':' << symbol.lineNumber << '\n';
+}
+
+void writeMap(const ObjectCode& objectCode, std::ostream& out)
+{
+	std::vector<MapSymbol> symbols = collectSymbols(objectCode);
+	const std::pmr::vector<Segment>& segments = objectCode.getSegments();
+	uint32_t basePtr = objectCode.getBasePtr();
+	size_t used = 0;
+
+	out << "Segments" << '\n';
+	out << "start    end      words" << '\n';
+
+	for (const Segment& segment : segments)
+	{
+		writeHex(out, basePtr + static_cast<uint32_t>(segment.begin), 8);
+		out << ' ';
+		writeHex(out, basePtr + static_cast<uint32_t>(segment.end), 8);
+		out << ' ' << std::dec << segment.end - segment.begin << '\n';
+		used += segment.end - segment.begin;
+	}
+
+	out << '\n' << "Symbols by address" << '\n';
+	out << "address  words    symbol, source" << '\n';
+
+	for (const MapSymbol& symbol : symbols)
+		writeSymbol(symbol, out);
+
+	// largest first, the order of equal sizes is kept
+	std::stable_sort(symbols.begin(), symbols.end(), [](const MapSymbol& a, const MapSymbol& b) { return a.size > b.size; });
+
+	out << '\n' << "Symbols by size" << '\n';
+	out << "address  words    symbol, source" << '\n';
+
+	for (const MapSymbol& symbol : symbols)
+		writeSymbol(symbol, out);
+
+	out << '\n' << "Memory usage" << '\n';
+	out << "used " << std::dec << used << " words" << '\n';
+	out << "free " << (used < memorySize ? memorySize - used : 0) << " of " << memorySize << " words" << '\n';
+}
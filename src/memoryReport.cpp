@@ -0,0 +1,259 @@
+#include "memoryReport.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <iomanip>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef MEMORY_REPORT
+const size_t stageCount = 8;
+const char* const stageNames[stageCount] = { "other", "source reading", "define expansion", "tokenization", "conversion", "encoding", "linking", "export" };
+
+struct StageCounters
+{
+	std::atomic<uint64_t> allocations;
+	std::atomic<uint64_t> bytes;
+	std::atomic<int64_t> peakHeap;	// largest counted live heap of all stages and threads seen by an allocation of this stage
+};
+
+static StageCounters counters[stageCount];
+static std::atomic<int64_t> heapBytes{ 0 };
+static std::atomic<bool> enabled{ false };
+static thread_local MEMORY_STAGE currentStage = MEMORY_STAGE::OTHER;
+
+// every allocation starts with a header which holds its size
+// blocks allocated while counting is enabled are flagged, only they are subtracted from the live heap when they are freed
+const size_t headerSize = alignof(std::max_align_t);
+const size_t countedFlag = ~(~static_cast<size_t>(0) >> 1);
+
+MemoryStage::MemoryStage(MEMORY_STAGE stage) : previous{ currentStage }
+{
+	currentStage = stage;
+}
+
+MemoryStage::~MemoryStage()
+{
+	currentStage = previous;
+}
+#endif
+
+void enableMemoryReport()
+{
+#ifdef MEMORY_REPORT
+	enabled = true;
+#endif
+}
+
+size_t getPeakRss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS memoryCounters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+		return memoryCounters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+	return 0;
+}
+
+void printMemoryReport(std::ostream& log, std::vector<std::pair<std::string, size_t>> containers)
+{
+	log << "Memory report:" << std::endl;
+
+#ifdef MEMORY_REPORT
+	// allocations of the report itself are not counted
+	enabled = false;
+
+	log << std::left << std::setw(20) << "stage" << std::right << std::setw(14) << "allocations" << std::setw(16) << "bytes" << std::setw(18) << "peak total heap" << std::endl;
+
+	for (size_t i = 0; i < stageCount; i++)
+	{
+		log << std::left << std::setw(20) << stageNames[i] << std::right
+			<< std::setw(14) << counters[i].allocations.load()
+			<< std::setw(16) << counters[i].bytes.load()
+			<< std::setw(18) << counters[i].peakHeap.load() << std::endl;
+	}
+#else
+	log << "allocations are only counted in builds with MEMORY_REPORT defined" << std::endl;
+#endif
+
+	log << "peak RSS: " << getPeakRss() << " bytes" << std::endl;
+
+	if (containers.empty())
+		return;
+
+	std::sort(containers.begin(), containers.end(), [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) { return a.second > b.second; });
+
+	log << "largest containers:" << std::endl;
+
+	for (std::pair<std::string, size_t>& container : containers)
+		log << std::left << std::setw(34) << container.first << std::right << std::setw(16) << container.second << " bytes" << std::endl;
+}
+
+#ifdef MEMORY_REPORT
+// returns the size with the counted flag if the allocation is counted
+static size_t countAllocation(size_t size)
+{
+	if (!enabled.load(std::memory_order_relaxed))
+		return size;
+
+	StageCounters& stage = counters[static_cast<size_t>(currentStage)];
+	stage.allocations.fetch_add(1, std::memory_order_relaxed);
+	stage.bytes.fetch_add(size, std::memory_order_relaxed);
+
+	int64_t heap = heapBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	int64_t peak = stage.peakHeap.load(std::memory_order_relaxed);
+
+	while (heap > peak && !stage.peakHeap.compare_exchange_weak(peak, heap, std::memory_order_relaxed));
+	return size | countedFlag;
+}
+
+static void countFree(size_t size)
+{
+	if (size & countedFlag)
+		heapBytes.fetch_sub(size & ~countedFlag, std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size)
+{
+	void* block = std::malloc(size + headerSize);
+	if (!block)
+		throw std::bad_alloc();
+
+	*static_cast<size_t*>(block) = countAllocation(size);
+	return static_cast<char*>(block) + headerSize;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+
+	void* block = static_cast<char*>(ptr) - headerSize;
+
+	countFree(*static_cast<size_t*>(block));
+	std::free(block);
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return operator new(size); }
+	catch (std::bad_alloc&) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return operator new(size); }
+	catch (std::bad_alloc&) { return nullptr; }
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	operator delete(ptr);
+}
+
+// over-aligned allocations keep the size and the start of the block right before the returned pointer
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+	void* block = std::malloc(size + align + sizeof(size_t) + sizeof(void*));
+	if (!block)
+		throw std::bad_alloc();
+
+	uintptr_t ptr = (reinterpret_cast<uintptr_t>(block) + sizeof(size_t) + sizeof(void*) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+	reinterpret_cast<size_t*>(ptr)[-1] = countAllocation(size);
+	reinterpret_cast<void**>(ptr - sizeof(size_t))[-1] = block;
+	return reinterpret_cast<void*>(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	if (!ptr)
+		return;
+
+	uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+
+	countFree(reinterpret_cast<size_t*>(address)[-1]);
+	std::free(reinterpret_cast<void**>(address - sizeof(size_t))[-1]);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return operator new(size, alignment); }
+	catch (std::bad_alloc&) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return operator new(size, alignment); }
+	catch (std::bad_alloc&) { return nullptr; }
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	operator delete(ptr, alignment);
+}
+#endif
@@ -2,15 +2,17 @@
 #include "converter.h"
 #include "parser.h"
 #include "constants.h"
+#include "fileTable.h"
+#include "memoryReport.h"
 
-#include <filesystem>
-#include <fstream>
-#include <iomanip>
-#include <cmath>
+#include <algorithm>
 
-ObjectCode::ObjectCode()
+// number of words which are kept before they get streamed to the writer
+const size_t streamBlockSize = 4096;
+
+ObjectCode::ObjectCode(std::pmr::memory_resource* resource) : writer{ nullptr }, flushed{ 0 }, basePtr{ defaultBasePtr }, references{ resource }, dereferences{ resource }, checksums{ resource }, lines{ resource }, segments{ resource }
 {
-	data.reserve(memorySize);
+
 }
 
 ObjectCode::~ObjectCode()
@@ -21,50 +23,213 @@ ObjectCode::~ObjectCode()
 void ObjectCode::append(uint32_t code)
 {
 	data.push_back(code);
+
+	if (writer && data.size() >= streamBlockSize)
+		flush();
 }
 
-void ObjectCode::append(std::vector<uint32_t> code)
+void ObjectCode::append(const std::vector<uint32_t>& code)
 {
 	data.insert(data.end(), code.begin(), code.end());
+
+	if (writer && data.size() >= streamBlockSize)
+		flush();
 }
 
-size_t ObjectCode::size()
+size_t ObjectCode::size() const
 {
-	return data.size();
+	return flushed + data.size();
 }
 
 void ObjectCode::resize(size_t n, const uint32_t& value)
 {
-	data.resize(n, value);
+	// when streaming, large gaps are written block by block
+	while (writer && n - flushed > streamBlockSize)
+	{
+		data.resize(streamBlockSize, value);
+		flush();
+	}
+
+	data.resize(n - flushed, value);
+}
+
+void ObjectCode::org(size_t pos)
+{
+	// the words in between belong to no segment and no source line
+	if (segments.empty())
+		segments.push_back({ 0, 0 });
+
+	segments.back().end = size();
+	addLine(noFileId, 0);
+	resize(pos, 0);
+	segments.push_back({ pos, pos });
+}
+
+void ObjectCode::endSegment()
+{
+	if (segments.empty())
+		segments.push_back({ 0, 0 });
+
+	segments.back().end = size();
+}
+
+const std::pmr::vector<Segment>& ObjectCode::getSegments() const
+{
+	return segments;
 }
 
 void ObjectCode::clear()
 {
 	data.clear();
-	references.clear();
-	dereferences.clear();
+	flushed = 0;
+
+	// the storage of the symbols is given back, so their memory resource can be released
+	references = std::pmr::vector<Reference>(references.get_allocator());
+	dereferences = std::pmr::vector<Dereference>(dereferences.get_allocator());
+	checksums = std::pmr::vector<Checksum>(checksums.get_allocator());
+	lines = std::pmr::vector<LineEntry>(lines.get_allocator());
+	segments = std::pmr::vector<Segment>(segments.get_allocator());
+	basePtr = defaultBasePtr;
 }
 
 bool ObjectCode::empty()
 {
-	return data.empty();
+	return size() == 0;
+}
+
+void ObjectCode::setBasePtr(uint32_t address)
+{
+	basePtr = address;
+}
+
+uint32_t ObjectCode::getBasePtr() const
+{
+	return basePtr;
 }
 
-void ObjectCode::addReference(std::string identifier, std::string sourceFile, unsigned int lineNumber)
+const std::vector<uint32_t>& ObjectCode::getData() const
 {
+	return data;
+}
+
+void ObjectCode::write(size_t pos, ObjectCode& code)
+{
+	// overwrites existing object code, used to fill reserved space
+	std::copy(code.data.begin(), code.data.end(), data.begin() + pos);
+}
+
+void ObjectCode::setWriter(ObjectWriter* writer)
+{
+	this->writer = writer;
+
+	// streamed object code never holds more than one block
+	if (writer)
+	{
+		std::vector<uint32_t>().swap(data);
+		data.reserve(streamBlockSize);
+	}
+}
+
+void ObjectCode::reserveImage()
+{
+	// streamed object code keeps its block size
+	if (!writer)
+		data.reserve(memorySize);
+}
+
+bool ObjectCode::isStreaming() const
+{
+	return writer != nullptr;
+}
+
+void ObjectCode::flush()
+{
+	if (!writer)
+		return;
+
+	writer->write(data);
+	flushed += data.size();
+	data.clear();
+
+	// nothing maps streamed words back to their lines, only the entry of the current line is kept
+	if (lines.size() > 1)
+		lines.erase(lines.begin(), lines.end() - 1);
+}
+
+void ObjectCode::addReference(std::string identifier, uint32_t fileId, unsigned int lineNumber)
+{
+	Reference reference = { std::pmr::string(identifier, references.get_allocator()), size(), fileId, lineNumber };
 	append(0x00000000); // placeholder which will be replaced by linking
-	Reference reference = { identifier, data.size() - 1, sourceFile, lineNumber };
-	references.push_back(reference);
+	references.push_back(std::move(reference));
 }
 
-void ObjectCode::addDereference(std::string identifier)
+void ObjectCode::addDereference(std::string identifier, uint32_t fileId, unsigned int lineNumber)
 {
-	Dereference dereference = { identifier, data.size() + basePtr };
-	dereferences.push_back(dereference);
+	Dereference dereference = { std::pmr::string(identifier, dereferences.get_allocator()), static_cast<uint32_t>(size() + basePtr), fileId, lineNumber };
+	dereferences.push_back(std::move(dereference));
+}
+
+const std::pmr::vector<Dereference>& ObjectCode::getDereferences() const
+{
+	return dereferences;
+}
+
+void ObjectCode::addLine(uint32_t fileId, unsigned int lineNumber)
+{
+	// a line which generated no words is replaced by the next one
+	if (!lines.empty() && lines.back().pos == size())
+		lines.pop_back();
+
+	// consecutive words of the same line share one entry
+	if (!lines.empty() && lines.back().fileId == fileId && lines.back().lineNumber == lineNumber)
+		return;
+
+	lines.push_back({ size(), fileId, lineNumber });
 }
 
-void ObjectCode::link(int& errorCount)
+const std::pmr::vector<LineEntry>& ObjectCode::getLines() const
 {
+	return lines;
+}
+
+void ObjectCode::addChecksum(CHECKSUM_TYPE type, std::string start, std::string end, uint32_t fileId, unsigned int lineNumber)
+{
+	Checksum checksum = { type, std::pmr::string(start, checksums.get_allocator()), std::pmr::string(end, checksums.get_allocator()), size(), fileId, lineNumber };
+	append(0x00000000); // placeholder which will be replaced after linking
+	checksums.push_back(std::move(checksum));
+}
+
+std::vector<std::pair<std::string, size_t>> ObjectCode::getMemoryUsage()
+{
+	size_t referenceBytes = references.capacity() * sizeof(Reference);
+	size_t dereferenceBytes = dereferences.capacity() * sizeof(Dereference);
+
+	for (Reference& reference : references)
+		referenceBytes += reference.identifier.capacity();
+	for (Dereference& dereference : dereferences)
+		dereferenceBytes += dereference.identifier.capacity();
+
+	return {
+		{ "ObjectCode::data", data.capacity() * sizeof(uint32_t) },
+		{ "ObjectCode::references", referenceBytes },
+		{ "ObjectCode::dereferences", dereferenceBytes },
+		{ "ObjectCode::lines", lines.capacity() * sizeof(LineEntry) } };
+}
+
+std::unordered_map<std::string, uint32_t> ObjectCode::getLabels()
+{
+	std::unordered_map<std::string, uint32_t> labels;
+
+	// like linking, the first definition of a label is used
+	for (Dereference& dereference : dereferences)
+		labels.emplace(std::string(dereference.identifier), dereference.address);
+
+	return labels;
+}
+
+void ObjectCode::link(int& errorCount, std::ostream& log)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::LINK };
 	bool found;
 
 	for (Reference& reference : references)
@@ -75,7 +240,12 @@ void ObjectCode::link(int& errorCount)
 		{
 			if (dereference.identifier == reference.identifier)
 			{
-				data.at(reference.pos) = dereference.address;
+				// words which are already streamed get patched in the file
+				if (reference.pos < flushed)
+					writer->patch(reference.pos, dereference.address);
+				else
+					data.at(reference.pos - flushed) = dereference.address;
+
 				found = true;
 				break;
 			}
@@ -83,122 +253,67 @@ void ObjectCode::link(int& errorCount)
 
 		if (!found)
 		{
-			std::cout << reference.sourceFile << ": line: " << reference.lineNumber << ": error: cannot resolve '" << reference.identifier << "'." << std::endl;
+			log << fileTable.getPath(reference.fileId) << ": line: " << reference.lineNumber << ": error: cannot resolve '" << reference.identifier << "'." << std::endl;
 			errorCount++;
 		}
 	}
 }
 
-bool ObjectCode::exportRaw(std::string path)
+void ObjectCode::applyChecksums(int& errorCount, std::ostream& log)
 {
-	removeQuotes(path);
-	if (!endsWith(path, ".hex"))
-		path += ".hex";
+	if (checksums.empty())
+		return;
 
-	std::filesystem::path fs_path = path;
-	fs_path = std::filesystem::absolute(fs_path);
+	std::unordered_map<std::string, uint32_t> labels = getLabels();
 
-	std::ofstream file;
-	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-	try
-	{
-		file.open(fs_path, std::ios::binary | std::ios::trunc);
-		for (uint32_t value : data)
-			file.write(reinterpret_cast<const char*>(&value), sizeof(uint32_t));
-	}
-	catch (std::ofstream::failure&)
+	// checksums are computed in order, a slot inside of the range is still zero
+	for (Checksum& checksum : checksums)
 	{
-		std::cout << "Fatal: error creating file " << fs_path << "!" << std::endl;
-		file.close();
-		return false;
+		auto start = labels.find(std::string(checksum.start));
+		auto end = labels.find(std::string(checksum.end));
+		std::string error;
+
+		if (start == labels.end())
+			error = "cannot resolve '" + std::string(checksum.start) + "'.";
+		else if (end == labels.end())
+			error = "cannot resolve '" + std::string(checksum.end) + "'.";
+		else if (start->second < basePtr || end->second < start->second || end->second - basePtr > data.size())
+			error = "invalid checksum range.";
+
+		if (!error.empty())
+		{
+			log << fileTable.getPath(checksum.fileId) << ": line: " << checksum.lineNumber << ": error: " << error << std::endl;
+			errorCount++;
+			continue;
+		}
+
+		data.at(checksum.pos) = computeChecksum(checksum.type, data.data() + (start->second - basePtr), end->second - start->second);
 	}
+}
 
-	file.close();
-	return true;
+bool ObjectCode::exportRaw(std::string path)
+{
+	RawWriter writer;
+	return exportTo(writer, path);
 }
 
 bool ObjectCode::exportMif(std::string path)
 {
-	removeQuotes(path);
-	if (!endsWith(path, ".mif"))
-		path += ".mif";
-
-	std::filesystem::path fs_path = path;
-	fs_path = std::filesystem::absolute(fs_path);
-
-	std::ofstream file;
-	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-	unsigned int fill = static_cast<unsigned int>(std::ceil(std::log2(memorySize) * 0.25));
-
-	try
-	{
-		file.open(fs_path, std::ios::trunc);
-		file << "DEPTH = " << memorySize << ";" << std::endl;
-		file << "WIDTH = 32;" << std::endl;
-		file << "ADDRESS_RADIX = HEX;" << std::endl;
-		file << "DATA_RADIX = HEX;" << std::endl;
-		file << "CONTENT" << std::endl;
-		file << "BEGIN" << std::endl;
-		file << std::endl;
-
-		for (size_t i = 0; i < data.size(); i++)
-		{
-			
-			file << std::setbase(16) << std::setw(fill) << std::setfill('0') << i << " : ";
-			file << std::setbase(16) << std::setw(8) << std::setfill('0') << data.at(i) << ";" << std::endl;
-		}
-
-		file << std::endl;
-		file << "END;" << std::endl;
-	}
-	catch (std::ofstream::failure&)
-	{
-		std::cout << "Fatal: error creating file " << fs_path << "!" << std::endl;
-		file.close();
-		return false;
-	}
-
-	file.close();
-	return true;
+	MifWriter writer;
+	return exportTo(writer, path);
 }
 
 bool ObjectCode::exportCoe(std::string path)
 {
-	removeQuotes(path);
-	if (!endsWith(path, ".coe"))
-		path += ".coe";
-
-	std::filesystem::path fs_path = path;
-	fs_path = std::filesystem::absolute(fs_path);
-
-	std::ofstream file;
-	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-	try
-	{
-		file.open(fs_path, std::ios::trunc);
-		file << "memory_initialization_radix=16;" << std::endl;
-		file << "memory_initialization_vector=" << std::endl;
-
-		for (size_t i = 0; i < data.size(); i++)
-		{
-			file << std::setbase(16) << std::setw(8) << std::setfill('0') << data.at(i);
+	CoeWriter writer;
+	return exportTo(writer, path);
+}
 
-			if (i == data.size() - 1)
-				file << ';' << std::endl;
-			else
-				file << ',' << std::endl;
-		}
-	}
-	catch (std::ofstream::failure&)
-	{
-		std::cout << "Fatal: error creating file " << fs_path << "!" << std::endl;
-		file.close();
+bool ObjectCode::exportTo(ObjectWriter& writer, std::string path) const
+{
+	if (!writer.open(path))
 		return false;
-	}
 
-	file.close();
-	return true;
+	writer.write(data);
+	return writer.close(true);
 }
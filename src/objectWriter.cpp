@@ -0,0 +1,539 @@
+#include "objectWriter.h"
+#include "constants.h"
+#include "parser.h"
+#include "converter.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+
+// 64 bit FNV-1a of a whole file
+static bool hashFile(std::filesystem::path path, uint64_t& hash)
+{
+	std::ifstream file(path, std::ios::binary);
+	char buffer[65536];
+
+	if (!file.is_open())
+		return false;
+
+	hash = 0xcbf29ce484222325;
+
+	while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+	{
+		for (std::streamsize i = 0; i < file.gcount(); i++)
+		{
+			hash ^= static_cast<unsigned char>(buffer[i]);
+			hash *= 0x100000001b3;
+		}
+	}
+
+	return true;
+}
+
+static void writeManifest(const std::filesystem::path& path, uint64_t hash)
+{
+	std::filesystem::path manifestPath = path;
+	manifestPath += ".hash";
+
+	std::error_code ec;
+	uintmax_t size = std::filesystem::file_size(path, ec);
+	int64_t lastWriteTime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+
+	if (ec)
+		return;
+
+	// the manifest is only a shortcut, so errors are ignored
+	std::ofstream manifest(manifestPath, std::ios::trunc);
+	manifest << std::hex << hash << ' ' << std::dec << size << ' ' << lastWriteTime << std::endl;
+}
+
+static bool isUnchanged(const std::filesystem::path& path, const std::filesystem::path& tempPath, uint64_t hash)
+{
+	std::error_code ec;
+	uintmax_t size = std::filesystem::file_size(path, ec);
+
+	if (ec || size != std::filesystem::file_size(tempPath, ec) || ec)
+		return false;
+
+	// <path>.hash holds the hash, size and modification time of the output
+	// as long as the output was not touched since, it does not have to be read again
+	std::filesystem::path manifestPath = path;
+	manifestPath += ".hash";
+	std::ifstream manifest(manifestPath);
+	uint64_t manifestHash;
+	uintmax_t manifestSize;
+	int64_t manifestTime;
+	int64_t lastWriteTime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+
+	if (!ec && manifest >> std::hex >> manifestHash >> std::dec >> manifestSize >> manifestTime && manifestSize == size && manifestTime == lastWriteTime)
+		return manifestHash == hash;
+
+	uint64_t existingHash;
+
+	if (!hashFile(path, existingHash) || existingHash != hash)
+		return false;
+
+	writeManifest(path, hash);
+	return true;
+}
+
+// replaces the destination by the complete temporary file, unless it is unchanged and only changed files are written
+static void replaceFile(const std::filesystem::path& path, const std::filesystem::path& tempPath, bool writeIfChanged, std::ostream& log)
+{
+	uint64_t hash = 0;
+
+	if (writeIfChanged && hashFile(tempPath, hash) && isUnchanged(path, tempPath, hash))
+	{
+		std::filesystem::remove(tempPath);
+		log << "Output " << path << " is unchanged." << std::endl;
+		return;
+	}
+
+	std::filesystem::rename(tempPath, path);
+
+	if (writeIfChanged)
+	{
+		writeManifest(path, hash);
+		log << "Output " << path << " was updated." << std::endl;
+	}
+}
+
+ObjectWriter::ObjectWriter() : out{ &file }, log{ &std::cout }, target{ nullptr }, writeIfChanged{ false }, dataBegin{ 0 }, lineSize{ 0 }, count{ 0 }, failed{ false }
+{
+	file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	buffer.exceptions(std::ios::failbit | std::ios::badbit);
+}
+
+ObjectWriter::~ObjectWriter()
+{
+	if (file.is_open() || target)
+		close(false);
+}
+
+void ObjectWriter::setLog(std::ostream& log)
+{
+	this->log = &log;
+}
+
+void ObjectWriter::setWriteIfChanged(bool writeIfChanged)
+{
+	this->writeIfChanged = writeIfChanged;
+}
+
+bool ObjectWriter::open(std::string path)
+{
+	removeQuotes(path);
+
+	// "-" is standard output
+	if (path == "-")
+		return open(std::cout);
+
+	if (!endsWith(path, getExtension()))
+		path += getExtension();
+
+	this->path = std::filesystem::absolute(path);
+	tempPath = this->path;
+	tempPath += ".tmp";
+	target = nullptr;
+	out = &file;
+	failed = false;
+
+	try { file.open(tempPath, isBinary() ? std::ios::binary | std::ios::trunc : std::ios::trunc); }
+	catch (std::ofstream::failure&)
+	{
+		fail();
+		return false;
+	}
+
+	return begin();
+}
+
+bool ObjectWriter::open(std::ostream& target)
+{
+	path = "<stream>";
+	tempPath.clear();
+	this->target = &target;
+	buffer.str("");
+	out = &buffer;
+	failed = false;
+
+	return begin();
+}
+
+bool ObjectWriter::begin()
+{
+	count = 0;
+	lineSize = 0;
+
+	try
+	{
+		writeHeader();
+		dataBegin = out->tellp();
+	}
+	catch (std::ios::failure&)
+	{
+		fail();
+		return false;
+	}
+
+	return true;
+}
+
+void ObjectWriter::write(const std::vector<uint32_t>& words)
+{
+	if (failed)
+		return;
+
+	try
+	{
+		for (uint32_t word : words)
+		{
+			writeLine(count++, word);
+
+			if (count == 1)
+				lineSize = out->tellp() - dataBegin;
+		}
+	}
+	catch (std::ios::failure&) { fail(); }
+}
+
+void ObjectWriter::patch(size_t pos, uint32_t word)
+{
+	if (failed)
+		return;
+
+	try
+	{
+		std::streampos end = out->tellp();
+		seekWord(pos);
+		writeWord(word);
+		out->seekp(end);
+	}
+	catch (std::ios::failure&) { fail(); }
+}
+
+bool ObjectWriter::close(bool keep)
+{
+	if (target)
+	{
+		std::ostream& target = *this->target;
+		this->target = nullptr;
+
+		try
+		{
+			if (!failed && keep)
+			{
+				writeFooter(count);
+				std::string content = buffer.str();
+				target.write(content.data(), content.size());
+				target.flush();
+			}
+		}
+		catch (std::ios::failure&) { fail(); }
+
+		buffer.str("");
+		return !failed && keep && target.good();
+	}
+
+	if (!failed && keep)
+	{
+		try
+		{
+			writeFooter(count);
+			file.close();
+			replaceFile(path, tempPath, writeIfChanged, *log);
+			return true;
+		}
+		catch (std::ofstream::failure&) { fail(); }
+		catch (std::filesystem::filesystem_error&) { fail(); }
+	}
+
+	// incomplete files never replace the destination
+	try { file.close(); }
+	catch (std::ofstream::failure&) {}
+
+	std::error_code ec;
+	std::filesystem::remove(tempPath, ec);
+	return false;
+}
+
+bool ObjectWriter::isBinary()
+{
+	return false;
+}
+
+void ObjectWriter::writeHeader()
+{
+
+}
+
+// formats without addresses only write the word
+void ObjectWriter::writeLine(size_t, uint32_t word)
+{
+	writeWord(word);
+}
+
+std::streamoff ObjectWriter::getWordOffset()
+{
+	return 0;
+}
+
+void ObjectWriter::writeFooter(size_t)
+{
+
+}
+
+void ObjectWriter::seekWord(size_t pos)
+{
+	out->seekp(dataBegin + static_cast<std::streamoff>(pos) * lineSize + getWordOffset());
+}
+
+void ObjectWriter::writeHex(uint32_t value, unsigned int digits)
+{
+	::writeHex(*out, value, digits);
+}
+
+bool ObjectWriter::hasFailed()
+{
+	return failed;
+}
+
+void ObjectWriter::fail()
+{
+	if (!failed)
+		*log << "Fatal: error creating file " << path << "!" << std::endl;
+
+	failed = true;
+}
+
+std::string RawWriter::getExtension()
+{
+	return ".hex";
+}
+
+bool RawWriter::isBinary()
+{
+	return true;
+}
+
+void RawWriter::writeWord(uint32_t word)
+{
+	out->write(reinterpret_cast<const char*>(&word), sizeof(uint32_t));
+}
+
+std::string RleWriter::getExtension()
+{
+	return ".rle";
+}
+
+std::string DeltaWriter::getExtension()
+{
+	return ".dlt";
+}
+
+MifWriter::MifWriter() : fill{ static_cast<unsigned int>(std::ceil(std::log2(memorySize) * 0.25)) }
+{
+
+}
+
+std::string MifWriter::getExtension()
+{
+	return ".mif";
+}
+
+void MifWriter::writeHeader()
+{
+	*out << "DEPTH = " << memorySize << ";" << '\n';
+	*out << "WIDTH = 32;" << '\n';
+	*out << "ADDRESS_RADIX = HEX;" << '\n';
+	*out << "DATA_RADIX = HEX;" << '\n';
+	*out << "CONTENT" << '\n';
+	*out << "BEGIN" << '\n';
+	*out << '\n';
+}
+
+void MifWriter::writeLine(size_t pos, uint32_t word)
+{
+	writeHex(static_cast<uint32_t>(pos), fill);
+	*out << " : ";
+	writeWord(word);
+	*out << ";" << '\n';
+}
+
+void MifWriter::writeWord(uint32_t word)
+{
+	writeHex(word, 8);
+}
+
+std::streamoff MifWriter::getWordOffset()
+{
+	return fill + 3;
+}
+
+void MifWriter::writeFooter(size_t)
+{
+	*out << '\n';
+	*out << "END;" << '\n';
+}
+
+std::string CoeWriter::getExtension()
+{
+	return ".coe";
+}
+
+void CoeWriter::writeHeader()
+{
+	*out << "memory_initialization_radix=16;" << '\n';
+	*out << "memory_initialization_vector=" << '\n';
+}
+
+void CoeWriter::writeLine(size_t, uint32_t word)
+{
+	writeWord(word);
+	*out << ',' << '\n';
+}
+
+void CoeWriter::writeWord(uint32_t word)
+{
+	writeHex(word, 8);
+}
+
+void CoeWriter::writeFooter(size_t count)
+{
+	// the last word is terminated by a semicolon
+	if (count > 0)
+	{
+		seekWord(count - 1);
+		out->seekp(8, std::ios::cur);
+		*out << ';';
+	}
+}
+
+MemWriter::MemWriter(unsigned int width, unsigned int shift, size_t begin, size_t depth) : width{ width }, shift{ shift }, begin{ begin }, depth{ depth }, pos{ 0 }, next{ SIZE_MAX },
+	fill{ static_cast<unsigned int>(std::ceil(std::log2(std::min<size_t>(memorySize, depth)) * 0.25)) }
+{
+
+}
+
+void MemWriter::write(const std::vector<uint32_t>& words)
+{
+	if (hasFailed())
+		return;
+
+	uint32_t mask = width >= 32 ? 0xFFFFFFFF : (1u << width) - 1;
+
+	try
+	{
+		for (uint32_t word : words)
+		{
+			size_t address = pos++ - begin;
+
+			// words outside of the address range wrap around to a large address
+			if (address >= depth)
+				continue;
+
+			word = (word >> shift) & mask;
+
+			if (word == 0)
+				continue;
+
+			// a new record starts after every skipped region
+			if (address != next)
+			{
+				*out << '@';
+				writeHex(static_cast<uint32_t>(address), fill);
+				*out << '\n';
+			}
+
+			writeWord(word);
+			*out << '\n';
+			next = address + 1;
+		}
+	}
+	catch (std::ofstream::failure&) { fail(); }
+}
+
+std::string MemWriter::getExtension()
+{
+	return ".mem";
+}
+
+void MemWriter::writeLine(size_t, uint32_t word)
+{
+	writeWord(word);
+	*out << '\n';
+}
+
+void MemWriter::writeWord(uint32_t word)
+{
+	writeHex(word, (width + 3) / 4);
+}
+
+std::unique_ptr<ObjectWriter> createObjectWriter(std::string option)
+{
+	if (option == "-mif")
+		return std::make_unique<MifWriter>();
+
+	if (option == "-coe")
+		return std::make_unique<CoeWriter>();
+
+	if (option == "-mem")
+		return std::make_unique<MemWriter>();
+
+	if (option == "-rle")
+		return std::make_unique<RleWriter>();
+
+	if (option == "-delta")
+		return std::make_unique<DeltaWriter>();
+
+	else
+		return std::make_unique<RawWriter>();
+}
+
+void writeHex(std::ostream& out, uint32_t value, unsigned int digits)
+{
+	out << std::setbase(16) << std::setw(digits) << std::setfill('0') << value;
+}
+
+bool writeReport(std::string path, std::string extension, bool binary, bool writeIfChanged, std::ostream& log, std::function<void(std::ostream&)> write)
+{
+	removeQuotes(path);
+
+	// "-" is standard output, which only gets complete reports
+	if (path == "-")
+	{
+		std::ostringstream buffer;
+		write(buffer);
+		std::string content = buffer.str();
+		std::cout.write(content.data(), content.size());
+		std::cout.flush();
+		return std::cout.good();
+	}
+
+	if (!endsWith(path, extension))
+		path += extension;
+
+	std::filesystem::path destination = std::filesystem::absolute(path);
+	std::filesystem::path tempPath = destination;
+	tempPath += ".tmp";
+
+	try
+	{
+		std::ofstream file;
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+		file.open(tempPath, binary ? std::ios::binary | std::ios::trunc : std::ios::trunc);
+		write(file);
+		file.close();
+		replaceFile(destination, tempPath, writeIfChanged, log);
+		return true;
+	}
+	catch (std::ofstream::failure&) {}
+	catch (std::filesystem::filesystem_error&) {}
+
+	// incomplete files never replace the destination
+	log << "Fatal: error creating file " << destination << "!" << std::endl;
+	std::error_code ec;
+	std::filesystem::remove(tempPath, ec);
+	return false;
+}
@@ -1,8 +1,10 @@
 #include "parser.h"
 #include "converter.h"
+#include "memoryReport.h"
 
 void parseLine(std::string line, std::vector<std::string>& tokens)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::TOKENIZE };
 	tokens.clear();
 	std::string token;
 	size_t pos;
@@ -82,7 +84,7 @@ bool parseAddress(std::string address, std::string& baseReg, std::string& offset
 			return false;
 	}
 
-	token_1 += address.substr(0, address.find_first_of(" \t+-"));	// parse first token
+	token_1 += address.substr(0, find_first_of_outside_parentheses(address, " \t+-"));	// parse first token
 
 	if (isInt(token_1))												// first token is offset
 		offset = token_1;
@@ -94,7 +96,7 @@ bool parseAddress(std::string address, std::string& baseReg, std::string& offset
 		baseReg = token_1;
 	}
 
-	address.erase(0, address.find_first_of(" \t+-"));				// cut first token
+	address.erase(0, find_first_of_outside_parentheses(address, " \t+-"));	// cut first token
 	address.erase(0, address.find_first_not_of(" \t"));				// cut whitespaces left
 
 	if (address.empty())
@@ -111,7 +113,7 @@ bool parseAddress(std::string address, std::string& baseReg, std::string& offset
 	else
 		return false;
 
-	token_2 += address.substr(0, address.find_first_of(" \t"));		// parse second token
+	token_2 += address.substr(0, find_first_of_outside_parentheses(address, " \t"));	// parse second token
 
 	if (isInt(token_2))
 	{
@@ -133,7 +135,7 @@ bool parseAddress(std::string address, std::string& baseReg, std::string& offset
 			return false;
 	}
 
-	address.erase(0, address.find_first_of(" \t"));					// cut second token
+	address.erase(0, find_first_of_outside_parentheses(address, " \t"));	// cut second token
 	address.erase(0, address.find_first_not_of(" \t"));				// cut whitespaces left
 	return address.empty();											// if address still not empty, return false
 }
@@ -214,3 +216,20 @@ size_t find_first_of_outside_str(std::string str, std::string charsToFind)
 	else
 		return std::string::npos;
 }
+
+size_t find_first_of_outside_parentheses(std::string str, std::string charsToFind)
+{
+	unsigned int depth = 0;
+
+	for (size_t pos = 0; pos < str.size(); pos++)
+	{
+		if (str.at(pos) == '(')
+			depth++;
+		else if (str.at(pos) == ')' && depth > 0)
+			depth--;
+		else if (depth == 0 && contains(charsToFind, str.at(pos)))
+			return pos;
+	}
+
+	return std::string::npos;
+}
@@ -0,0 +1,92 @@
+#include "prefetcher.h"
+
+// number of files which are read at the same time
+const unsigned int prefetchThreadCount = 4;
+
+Prefetcher::Prefetcher(std::function<std::shared_ptr<const SourceBuffer>(uint32_t)> loadFunc) : loadFunc{ loadFunc }, stop{ false }
+{
+
+}
+
+Prefetcher::~Prefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stop = true;
+		tasks.clear();
+	}
+
+	condition.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+void Prefetcher::prefetch(uint32_t fileId)
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (buffers.count(fileId))
+			return;
+
+		// threads are only started once there is something to read
+		if (threads.empty())
+		{
+			for (unsigned int i = 0; i < prefetchThreadCount; i++)
+				threads.emplace_back(&Prefetcher::work, this);
+		}
+
+		tasks.emplace_back(std::bind(loadFunc, fileId));
+		buffers.emplace(fileId, tasks.back().get_future().share());
+	}
+
+	condition.notify_one();
+}
+
+std::shared_ptr<const SourceBuffer> Prefetcher::take(uint32_t fileId)
+{
+	std::shared_future<std::shared_ptr<const SourceBuffer>> buffer;
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto it = buffers.find(fileId);
+		if (it == buffers.end())
+			return nullptr;
+
+		buffer = it->second;
+		buffers.erase(it);
+	}
+
+	// waits until the file is read, errors of loadFunc are thrown here
+	return buffer.get();
+}
+
+void Prefetcher::clear()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	tasks.clear();
+	buffers.clear();
+}
+
+void Prefetcher::work()
+{
+	while (true)
+	{
+		std::packaged_task<std::shared_ptr<const SourceBuffer>()> task;
+
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			condition.wait(lock, [this]() { return stop || !tasks.empty(); });
+
+			if (stop)
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,360 @@
+#include "profiler.h"
+#include "constants.h"
+#include "fileTable.h"
+
+#include <thread>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+const size_t minSamplesPerThread = 1 << 20;
+const size_t maxStackDepth = 1024;	// a broken trace or runaway recursion must not grow the stack forever
+const uint32_t noSymbol = 0xFFFFFFFF;
+
+// node of the call tree, every node stands for the stack from the root up to its frame
+struct StackNode
+{
+	uint32_t parent;
+	uint32_t frame;
+};
+
+// index of the symbol every word belongs to, noSymbol in front of the first label
+static std::vector<uint32_t> mapSymbols(const std::vector<MapSymbol>& symbols, uint32_t basePtr, size_t size)
+{
+	std::vector<uint32_t> symbolAt(size, noSymbol);
+
+	for (size_t i = 0; i < symbols.size(); i++)
+	{
+		if (symbols.at(i).address < basePtr)
+			continue;
+
+		size_t begin = std::min<size_t>(symbols.at(i).address - basePtr, size);
+		size_t end = i + 1 < symbols.size() ? std::min<size_t>(symbols.at(i + 1).address - basePtr, size) : size;
+		std::fill(symbolAt.begin() + begin, symbolAt.begin() + std::max(begin, end), static_cast<uint32_t>(i));
+	}
+
+	return symbolAt;
+}
+
+void Profile::build(const ObjectCode& objectCode, const std::vector<uint32_t>& trace)
+{
+	const std::vector<uint32_t>& data = objectCode.getData();
+	uint32_t basePtr = objectCode.getBasePtr();
+	size_t size = data.size();
+
+	symbols = collectSymbols(objectCode);
+	total = trace.size();
+
+	// samples are counted in chunks, the last slot of each chunk counts the samples outside of the object code
+	size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), trace.size() / minSamplesPerThread));
+	size_t chunkSize = (trace.size() + threadCount - 1) / threadCount;
+	std::vector<std::vector<uint64_t>> chunkCounts(threadCount, std::vector<uint64_t>(size + 1));
+	std::vector<std::thread> threads;
+
+	auto countChunk = [&](size_t index)
+	{
+		std::vector<uint64_t>& counts = chunkCounts.at(index);
+		size_t end = std::min(trace.size(), (index + 1) * chunkSize);
+
+		for (size_t i = index * chunkSize; i < end; i++)
+		{
+			// addresses below the base pointer wrap around
+			uint32_t pos = trace[i] - basePtr;
+			counts[pos < size ? pos : size]++;
+		}
+	};
+
+	for (size_t t = 0; t < threadCount; t++)
+		threads.emplace_back(countChunk, t);
+
+	// the stack depends on every sample before, so it is reconstructed in order while the samples are counted
+	std::vector<uint32_t> symbolAt = mapSymbols(symbols, basePtr, size);
+	uint32_t unknownFrame = static_cast<uint32_t>(symbols.size());
+	std::vector<StackNode> nodes;
+	std::vector<uint64_t> nodeCounts;
+	std::unordered_map<uint64_t, uint32_t> children;
+	std::vector<uint32_t> path;	// node of every frame of the current stack
+	uint32_t previous = 0;
+	uint32_t node = 0;
+
+	auto getFrame = [&](uint32_t address)
+	{
+		uint32_t pos = address - basePtr;
+		return pos < size && symbolAt[pos] != noSymbol ? symbolAt[pos] : unknownFrame;
+	};
+
+	auto getChild = [&](uint32_t parent, uint32_t frame)
+	{
+		auto result = children.emplace((static_cast<uint64_t>(parent) << 32) | frame, static_cast<uint32_t>(nodes.size()));
+
+		if (result.second)
+		{
+			nodes.push_back({ parent, frame });
+			nodeCounts.push_back(0);
+		}
+
+		return result.first->second;
+	};
+
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		uint32_t address = trace[i];
+
+		// repeated samples of a stalled instruction keep the stack
+		if (i > 0 && address == previous)
+		{
+			nodeCounts[node]++;
+			continue;
+		}
+
+		uint32_t frame = getFrame(address);
+		uint32_t pos = previous - basePtr;
+
+		if (i == 0)
+			path.push_back(getChild(noSymbol, frame));
+
+		// effect of the previous instruction on the stack
+		else if (pos < size)
+		{
+			uint32_t word = data[pos];
+			INST opcode = static_cast<INST>(word >> 27);
+			uint32_t next = previous + 1 + ((word >> 26) & 1);
+
+			if (opcode == INST::RET || opcode == INST::RETI)
+			{
+				if (path.size() > 1)
+					path.pop_back();
+			}
+			// a call, or an interrupt when an instruction which does not write the PC is not followed by the next one
+			else if (address != next && (opcode == INST::CALL || (opcode != INST::JMP && (word & 0x3F) != PC)))
+			{
+				if (path.size() < maxStackDepth)
+					path.push_back(getChild(path.back(), frame));
+			}
+		}
+
+		// the leaf is the routine of the sample, which differs from the called one after jumping to another label
+		node = path.back();
+		if (nodes[node].frame != frame)
+			node = getChild(node, frame);
+
+		nodeCounts[node]++;
+		previous = address;
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	counts.assign(size, 0);
+	outside = 0;
+
+	for (const std::vector<uint64_t>& chunk : chunkCounts)
+	{
+		for (size_t pos = 0; pos < size; pos++)
+			counts[pos] += chunk[pos];
+
+		outside += chunk[size];
+	}
+
+	stacks.clear();
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodeCounts[i] == 0)
+			continue;
+
+		std::string stack;
+
+		for (uint32_t n = static_cast<uint32_t>(i); n != noSymbol; n = nodes[n].parent)
+		{
+			const std::string& name = nodes[n].frame == unknownFrame ? "[unknown]" : symbols.at(nodes[n].frame).name;
+			stack = stack.empty() ? name : name + ";" + stack;
+		}
+
+		stacks.emplace_back(stack, nodeCounts[i]);
+	}
+
+	std::sort(stacks.begin(), stacks.end());
+}
+
+static void writeCount(const Profile& profile, uint64_t count, std::ostream& out)
+{
+	double percent = profile.total > 0 ? 100.0 * count / profile.total : 0.0;
+	out << std::dec << std::setw(10) << std::setfill(' ') << std::left << count << std::right;
+	out << std::setw(6) << std::fixed << std::setprecision(2) << percent << "%  ";
+}
+
+static void writeSummary(const ObjectCode& objectCode, const Profile& profile, std::ostream& out)
+{
+	std::vector<uint32_t> symbolAt = mapSymbols(profile.symbols, objectCode.getBasePtr(), profile.counts.size());
+	std::vector<uint64_t> routineCounts(profile.symbols.size());
+	uint64_t noSymbolCount = profile.outside;
+
+	for (size_t pos = 0; pos < profile.counts.size(); pos++)
+	{
+		if (symbolAt[pos] == noSymbol)
+			noSymbolCount += profile.counts[pos];
+		else
+			routineCounts[symbolAt[pos]] += profile.counts[pos];
+	}
+
+	// lines in order of their address, the samples of a line are summed over all of its entries
+	const std::pmr::vector<LineEntry>& lines = objectCode.getLines();
+	std::vector<std::pair<uint64_t, uint64_t>> lineCounts;
+	std::unordered_map<uint64_t, size_t> lineIndices;
+	uint64_t noLineCount = profile.outside;
+
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		size_t end = i + 1 < lines.size() ? std::min(lines.at(i + 1).pos, profile.counts.size()) : profile.counts.size();
+		uint64_t count = 0;
+
+		for (size_t pos = lines.at(i).pos; pos < end; pos++)
+			count += profile.counts[pos];
+
+		if (lines.at(i).fileId == noFileId)
+		{
+			noLineCount += count;
+			continue;
+		}
+
+		uint64_t line = (static_cast<uint64_t>(lines.at(i).fileId) << 32) | lines.at(i).lineNumber;
+		auto result = lineIndices.emplace(line, lineCounts.size());
+
+		if (result.second)
+			lineCounts.emplace_back(line, 0);
+
+		lineCounts.at(result.first->second).second += count;
+	}
+
+	out << "Profile" << '\n';
+	out << "samples " << std::dec << profile.total << '\n';
+	out << "outside " << profile.outside << " samples" << '\n';
+
+	// most samples first, the order of equal counts is kept
+	std::vector<size_t> routines(profile.symbols.size());
+	for (size_t i = 0; i < routines.size(); i++)
+		routines[i] = i;
+
+	std::stable_sort(routines.begin(), routines.end(), [&](size_t a, size_t b) { return routineCounts[a] > routineCounts[b]; });
+
+	out << '\n' << "Samples by routine" << '\n';
+	out << "samples   percent  symbol, source" << '\n';
+
+	for (size_t i : routines)
+	{
+		if (routineCounts[i] == 0)
+			break;
+
+		const MapSymbol& symbol = profile.symbols.at(i);
+		writeCount(profile, routineCounts[i], out);
+		out << symbol.name << ", " << fileTable.getPath(symbol.fileId) << ':' << symbol.lineNumber << '\n';
+	}
+
+	if (noSymbolCount > 0)
+	{
+		writeCount(profile, noSymbolCount, out);
+		out << "[unknown]" << '\n';
+	}
+
+	std::stable_sort(lineCounts.begin(), lineCounts.end(), [](const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b) { return a.second > b.second; });
+
+	out << '\n' << "Samples by line" << '\n';
+	out << "samples   percent  source" << '\n';
+
+	for (const std::pair<uint64_t, uint64_t>& line : lineCounts)
+	{
+		if (line.second == 0)
+			break;
+
+		writeCount(profile, line.second, out);
+		out << fileTable.getPath(static_cast<uint32_t>(line.first >> 32)) << ':' << static_cast<uint32_t>(line.first) << '\n';
+	}
+
+	if (noLineCount > 0)
+	{
+		writeCount(profile, noLineCount, out);
+		out << "[unknown]" << '\n';
+	}
+}
+
+static void writeAnnotated(const ObjectCode& objectCode, const Profile& profile, std::ostream& out)
+{
+	// samples of every line of the files which have been sampled at all
+	const std::pmr::vector<LineEntry>& lines = objectCode.getLines();
+	std::map<uint32_t, std::unordered_map<unsigned int, uint64_t>> files;
+
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		size_t end = i + 1 < lines.size() ? std::min(lines.at(i + 1).pos, profile.counts.size()) : profile.counts.size();
+		uint64_t count = 0;
+
+		for (size_t pos = lines.at(i).pos; pos < end; pos++)
+			count += profile.counts[pos];
+
+		if (count > 0 && lines.at(i).fileId != noFileId)
+			files[lines.at(i).fileId][lines.at(i).lineNumber] += count;
+	}
+
+	for (const auto& file : files)
+	{
+		const std::string& path = fileTable.getPath(file.first);
+		std::ifstream source(path);
+
+		out << "==== " << path << '\n';
+
+		if (!source.is_open())
+		{
+			out << "source not available" << '\n' << '\n';
+			continue;
+		}
+
+		std::string text;
+
+		for (unsigned int lineNumber = 1; std::getline(source, text); lineNumber++)
+		{
+			if (!text.empty() && text.back() == '\r')
+				text.pop_back();
+
+			auto it = file.second.find(lineNumber);
+
+			if (it != file.second.end())
+				writeCount(profile, it->second, out);
+			else
+				out << std::string(19, ' ');
+
+			out << "| " << text << '\n';
+		}
+
+		out << '\n';
+	}
+}
+
+static void writeFolded(const Profile& profile, std::ostream& out)
+{
+	// one line per stack, frames from the root to the leaf separated by ';', as expected by flamegraph.pl
+	for (const std::pair<std::string, uint64_t>& stack : profile.stacks)
+		out << stack.first << ' ' << std::dec << stack.second << '\n';
+}
+
+std::string getProfileExtension(PROFILE_OUTPUT output)
+{
+	switch (output)
+	{
+	case PROFILE_OUTPUT::REPORT:	return ".prof";
+	case PROFILE_OUTPUT::ANNOTATED:	return ".annotated";
+	default:						return ".folded";
+	}
+}
+
+void writeProfile(const ObjectCode& objectCode, const Profile& profile, PROFILE_OUTPUT output, std::ostream& out)
+{
+	switch (output)
+	{
+	case PROFILE_OUTPUT::REPORT:	writeSummary(objectCode, profile, out);	break;
+	case PROFILE_OUTPUT::ANNOTATED:	writeAnnotated(objectCode, profile, out);	break;
+	case PROFILE_OUTPUT::FOLDED:	writeFolded(profile, out);	break;
+	}
+}
@@ -0,0 +1,122 @@
+#include "sourceCache.h"
+#include "fileTable.h"
+
+SourceCache::SourceCache() : precompiled{ false }
+{
+
+}
+
+SourceCache::~SourceCache()
+{
+	clear();
+}
+
+void SourceCache::setPrecompiled(bool precompiled)
+{
+	this->precompiled = precompiled;
+}
+
+std::shared_ptr<const SourceBuffer> SourceCache::getBuffer(uint32_t fileId)
+{
+	std::filesystem::path path = fileTable.getPath(fileId);
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto it = entries.find(fileId);
+		if (it != entries.end() && it->second.buffer)
+			return it->second.buffer;
+	}
+
+	// time is taken before reading, so changes during reading are detected by the next refresh
+	std::error_code ec;
+	std::filesystem::file_time_type lastWriteTime = std::filesystem::last_write_time(path, ec);
+
+	// load outside of the lock, so other files can be read in the meantime
+	// if two compilers miss the same file, the first buffer is kept
+	std::shared_ptr<SourceBuffer> buffer = std::make_shared<SourceBuffer>();
+	try
+	{
+		if (precompiled)
+			buffer->loadPrecompiled(path);
+		else
+			buffer->load(path, true);
+	}
+	catch (std::ifstream::failure&)
+	{
+		addMissing(fileId);
+		throw;
+	}
+
+	std::lock_guard<std::mutex> lock{ mutex };
+	Entry& entry = entries[fileId];
+	if (!entry.buffer)
+		entry = Entry{ buffer, lastWriteTime };
+
+	return entry.buffer;
+}
+
+void SourceCache::addMissing(uint32_t fileId)
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	entries.emplace(fileId, Entry{ nullptr, std::filesystem::file_time_type{} });
+}
+
+bool SourceCache::refresh()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	bool changed = false;
+
+	// only changed files are read and lexed again, buffers still in use by a compiler stay valid
+	for (auto it = entries.begin(); it != entries.end();)
+	{
+		std::error_code ec;
+		std::filesystem::path path = fileTable.getPath(it->first);
+		std::filesystem::file_time_type lastWriteTime = std::filesystem::last_write_time(path, ec);
+
+		if (!it->second.buffer)
+		{
+			// a missing file got created, it is read by the next compilation
+			if (!ec)
+			{
+				changed = true;
+				it = entries.erase(it);
+			}
+			else
+				it++;
+			continue;
+		}
+
+		if (!ec && lastWriteTime == it->second.lastWriteTime)
+		{
+			it++;
+			continue;
+		}
+
+		changed = true;
+
+		try
+		{
+			std::shared_ptr<SourceBuffer> buffer = std::make_shared<SourceBuffer>();
+			if (precompiled)
+				buffer->loadPrecompiled(path);
+			else
+				buffer->load(path, true);
+			it->second = Entry{ buffer, lastWriteTime };
+			it++;
+		}
+		// removed files are kept as missing, the next compilation reports them
+		catch (std::ifstream::failure&)
+		{
+			it->second = Entry{ nullptr, std::filesystem::file_time_type{} };
+			it++;
+		}
+	}
+
+	return changed;
+}
+
+void SourceCache::clear()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	entries.clear();
+}
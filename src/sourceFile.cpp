@@ -1,37 +1,292 @@
 #include "sourceFile.h"
+#include "parser.h"
+#include "fileTable.h"
+#include "memoryReport.h"
 
-SourceFile::SourceFile(std::filesystem::path path) : path{ path }, lineNumber{ 0 }
+#include <algorithm>
+#include <iterator>
+#include <random>
+
+// precompiled files are stored next to the source file as <source file>.pch
+const char precompiledMagic[4] = { 'A', 'P', 'C', 'H' };
+const uint64_t precompiledVersion = 1;
+
+static std::string readFile(std::filesystem::path path)
 {
+	std::ifstream file;
 	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	file.open(path); 
+	file.open(path);
+
+	std::string content{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+	file.close();
+	return content;
 }
 
-SourceFile::~SourceFile()
+// 64 bit FNV-1a
+static uint64_t hashContent(std::string& content)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+
+	for (const char& c : content)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+static void writeVarint(std::ostream& stream, uint64_t value)
+{
+	do
+	{
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+		stream.put(static_cast<char>(value ? byte | 0x80 : byte));
+	} while (value);
+}
+
+static bool readVarint(std::istream& stream, uint64_t& value)
+{
+	value = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = stream.get();
+		if (byte == std::char_traits<char>::eof())
+			return false;
+
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+static void writeString(std::ostream& stream, const std::string& str)
 {
+	writeVarint(stream, str.size());
+	stream.write(str.data(), str.size());
+}
+
+static bool readString(std::istream& stream, std::string& str, uint64_t maxSize)
+{
+	uint64_t size;
+	if (!readVarint(stream, size) || size > maxSize)
+		return false;
+
+	str.resize(size);
+	return size == 0 || stream.read(&str.at(0), size);
+}
+
+void SourceBuffer::load(std::filesystem::path path, bool lex)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::READ };
+	std::string content = readFile(path);
+
+	split(content);
+	tokens.clear();
+
+	if (lex)
+		this->lex();
+}
+
+void SourceBuffer::load(std::istream& stream)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::READ };
+	std::string content{ std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{} };
+
+	split(content);
+	tokens.clear();
+}
+
+void SourceBuffer::loadPrecompiled(std::filesystem::path path)
+{
+	MemoryStage memoryStage{ MEMORY_STAGE::READ };
+	std::filesystem::path precompiledPath = path;
+	precompiledPath += ".pch";
+
+	std::error_code ec;
+	int64_t lastWriteTime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+	uint64_t size = ec ? 0 : std::filesystem::file_size(path, ec);
+
+	// let load() report the error
+	if (ec)
+	{
+		load(path, true);
+		return;
+	}
+
+	std::ifstream file{ precompiledPath, std::ios::binary };
+	char magic[sizeof(precompiledMagic)];
+	uint64_t version = 0, fileLastWriteTime = 0, fileSize = 0, fileHash = 0;
+
+	bool valid = file.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), precompiledMagic) &&
+		readVarint(file, version) && version == precompiledVersion &&
+		readVarint(file, fileLastWriteTime) && readVarint(file, fileSize) && readVarint(file, fileHash);
+
+	// source file is unchanged, it does not need to be read at all
+	if (valid && static_cast<int64_t>(fileLastWriteTime) == lastWriteTime && fileSize == size)
+	{
+		if (readPrecompiled(file, size))
+			return;
+
+		// the body is corrupt, reading it again from the start would fail the same way
+		valid = false;
+	}
+
+	std::string content = readFile(path);
+	uint64_t hash = hashContent(content);
+
+	// source file was touched but has the same content, only the key gets updated
+	if (valid && fileHash == hash && readPrecompiled(file, size))
+	{
+		file.close();
+		writePrecompiled(precompiledPath, lastWriteTime, size, hash);
+		return;
+	}
+
+	file.close();
+	split(content);
+	lex();
+	writePrecompiled(precompiledPath, lastWriteTime, size, hash);
+}
+
+void SourceBuffer::split(std::string& content)
+{
+	size_t pos = 0;
+
+	// same lines std::getline() would return
+	lines.clear();
+	while (pos < content.size())
+	{
+		size_t end = content.find('\n', pos);
+		if (end == std::string::npos)
+			end = content.size();
+
+		lines.push_back(content.substr(pos, end - pos));
+		pos = end + 1;
+	}
+}
+
+void SourceBuffer::lex()
+{
+	tokens.resize(lines.size());
+	for (size_t i = 0; i < lines.size(); i++)
+		parseLine(lines.at(i), tokens.at(i));
+}
+
+bool SourceBuffer::readPrecompiled(std::ifstream& file, uint64_t size)
+{
+	// nothing can be larger than the source file, which protects against corrupted files
+	uint64_t lineCount;
+	if (!readVarint(file, lineCount) || lineCount > size)
+		return false;
+
+	lines.resize(lineCount);
+	tokens.resize(lineCount);
+
+	for (size_t i = 0; i < lineCount; i++)
+	{
+		uint64_t tokenCount;
+		if (!readString(file, lines.at(i), size) || !readVarint(file, tokenCount) || tokenCount > size)
+			return false;
+
+		tokens.at(i).resize(tokenCount);
+		for (std::string& token : tokens.at(i))
+		{
+			if (!readString(file, token, size))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void SourceBuffer::writePrecompiled(std::filesystem::path path, int64_t lastWriteTime, uint64_t size, uint64_t hash)
+{
+	// failing to write the file only costs time on the next run
+	// the file is written under a name of its own and renamed, so concurrent builds never read or write a partly written file
+	std::filesystem::path tempPath = path;
+	tempPath += "." + std::to_string(std::random_device{}()) + ".tmp";
+
+	std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+	if (!file.is_open())
+		return;
+
+	file.write(precompiledMagic, sizeof(precompiledMagic));
+	writeVarint(file, precompiledVersion);
+	writeVarint(file, static_cast<uint64_t>(lastWriteTime));
+	writeVarint(file, size);
+	writeVarint(file, hash);
+	writeVarint(file, lines.size());
+
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		writeString(file, lines.at(i));
+		writeVarint(file, tokens.at(i).size());
+		for (std::string& token : tokens.at(i))
+			writeString(file, token);
+	}
+
 	file.close();
+	std::error_code ec;
+
+	if (file.fail())
+		std::filesystem::remove(tempPath, ec);
+	else
+	{
+		std::filesystem::rename(tempPath, path, ec);
+
+		if (ec)
+			std::filesystem::remove(tempPath, ec);
+	}
 }
 
-std::string SourceFile::getPath()
+SourceFile::SourceFile(uint32_t fileId, std::shared_ptr<const SourceBuffer> buffer) : fileId{ fileId }, buffer{ buffer }, lineNumber{ 0 }
 {
-	return path.string();
+	// files which are not shared get loaded without tokens
+	if (!this->buffer)
+	{
+		std::shared_ptr<SourceBuffer> newBuffer = std::make_shared<SourceBuffer>();
+		newBuffer->load(fileTable.getPath(fileId), false);
+		this->buffer = newBuffer;
+	}
+}
+
+SourceFile::~SourceFile()
+{
+
+}
+
+uint32_t SourceFile::getFileId()
+{
+	return fileId;
 }
 
 bool SourceFile::getLine(std::string& line)
 {
-	try
+	if (lineNumber < buffer->lines.size())
 	{
-		std::getline(file, line);
+		line = buffer->lines.at(lineNumber);
 		lineNumber++;
 		return true;
 	}
-	catch (std::ifstream::failure&)
-	{
-		line.clear();
-		return false;
-	}
+
+	line.clear();
+	return false;
+}
+
+const std::vector<std::string>* SourceFile::getTokens()
+{
+	if (lineNumber == 0 || lineNumber > buffer->tokens.size())
+		return nullptr;
+
+	return &buffer->tokens.at(lineNumber - 1);
 }
 
 unsigned int SourceFile::getLineNumber()
 {
 	return lineNumber;
-}
\ No newline at end of file
+}
@@ -1,9 +1,12 @@
 #include "sourceFileManager.h"
 #include "converter.h"
+#include "fileTable.h"
+#include "parser.h"
+#include "memoryReport.h"
 
 #include <iostream>
 
-SourceFileManager::SourceFileManager()
+SourceFileManager::SourceFileManager() : cache{ nullptr }, precompiled{ false }, prefetcher{ std::bind(&SourceFileManager::loadBuffer, this, std::placeholders::_1) }
 {
 
 }
@@ -13,74 +16,207 @@ SourceFileManager::~SourceFileManager()
 	closeAll();
 }
 
+void SourceFileManager::setCache(SourceCache* cache)
+{
+	this->cache = cache;
+}
+
+void SourceFileManager::setPrecompiled(bool precompiled)
+{
+	this->precompiled = precompiled;
+}
+
+void SourceFileManager::setIncludePaths(const std::vector<std::string>& includePaths)
+{
+	this->includePaths.clear();
+
+	for (const std::string& includePath : includePaths)
+		this->includePaths.push_back(std::filesystem::absolute(includePath));
+}
+
 bool SourceFileManager::addFile(std::string path)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::READ };
 	removeQuotes(path);
-	std::filesystem::path fs_path = path;
+	uint32_t fileId;
+
+	// "-" reads the 1st file from standard input
+	if (sourceFileStack.empty() && path == "-")
+		return addStream("<stdin>", std::cin);
 
 	// path of 1st file is either absolute or relative to the executable
 	if (sourceFileStack.empty())
 	{
-		fs_path = std::filesystem::absolute(fs_path);
+		std::filesystem::path fs_path = std::filesystem::absolute(path);
 		basePath = fs_path.parent_path();
+		fileId = fileTable.getId(fs_path);
+		resolvedPaths.clear();
 	}
-	// path of nth file is either absolute or relative to parent directory of 1st file
 	else
-	{
-		if (fs_path.is_relative())
-			fs_path = basePath / fs_path;
-		else
-			fs_path = std::filesystem::absolute(fs_path);
-	}
+		fileId = resolvePath(path);
 
-	for (std::filesystem::path& included_fs_path : included_fs_paths)
-	{
-		if (fs_path == included_fs_path)
-			return true;
-	}
+	if (includedFiles.count(fileId))
+		return true;
 
 	try
 	{
-		SourceFile* sourceFile = new SourceFile{ fs_path };
-		sourceFileStack.push_back(sourceFile);
-		included_fs_paths.push_back(fs_path);
+		// prefetched files are most likely read already
+		std::shared_ptr<const SourceBuffer> buffer = prefetcher.take(fileId);
+		if (!buffer)
+			buffer = loadBuffer(fileId);
+
+		prefetchIncludes(*buffer);
+		sourceFileStack.emplace_back(fileId, buffer);
+		includedFiles.insert(fileId);
 		return true;
 	}
 	catch (std::ifstream::failure&){ return false; }
 }
 
-void SourceFileManager::closeAll()
+bool SourceFileManager::addStream(std::string name, std::istream& stream)
 {
-	for (SourceFile*& sourceFile : sourceFileStack)
-		delete sourceFile;
+	MemoryStage memoryStage{ MEMORY_STAGE::READ };
+
+	// streams are only read as 1st file, their includes are relative to the working directory
+	if (!sourceFileStack.empty())
+		return false;
+
+	basePath = std::filesystem::current_path();
+	uint32_t fileId = fileTable.getId(name);
+	resolvedPaths.clear();
+
+	std::shared_ptr<SourceBuffer> buffer = std::make_shared<SourceBuffer>();
+	buffer->load(stream);
+
+	if (stream.bad())
+		return false;
+
+	prefetchIncludes(*buffer);
+	sourceFileStack.emplace_back(fileId, buffer);
+	includedFiles.insert(fileId);
+	return true;
+}
 
+void SourceFileManager::closeAll()
+{
+	prefetcher.clear();
 	sourceFileStack.clear();
-	included_fs_paths.clear();
+	includedFiles.clear();
+	resolvedPaths.clear();
 	basePath.clear();
 }
 
-std::string SourceFileManager::getPath()
+const std::string& SourceFileManager::getPath()
 {
-	return sourceFileStack.back()->getPath();
+	return fileTable.getPath(sourceFileStack.back().getFileId());
+}
+
+uint32_t SourceFileManager::getFileId()
+{
+	return sourceFileStack.back().getFileId();
 }
 
 bool SourceFileManager::getLine(std::string& line)
 {
+	MemoryStage memoryStage{ MEMORY_STAGE::READ };
 	while (!sourceFileStack.empty())
 	{
-		if (sourceFileStack.back()->getLine(line))
+		if (sourceFileStack.back().getLine(line))
 			return true;
 		else
-		{
-			delete sourceFileStack.back();
 			sourceFileStack.pop_back();
-		}
 	}
 
 	return false;
 }
 
+const std::vector<std::string>* SourceFileManager::getTokens()
+{
+	return sourceFileStack.back().getTokens();
+}
+
 unsigned int SourceFileManager::getLineNumber()
 {
-	return sourceFileStack.back()->getLineNumber();
+	return sourceFileStack.back().getLineNumber();
+}
+
+uint32_t SourceFileManager::resolvePath(std::string path)
+{
+	// path of nth file is either absolute or relative to parent directory of 1st file or one of the include paths
+	// it only needs to be resolved the first time it is included
+	auto it = resolvedPaths.find(path);
+	if (it != resolvedPaths.end())
+		return it->second;
+
+	std::filesystem::path fs_path = path;
+
+	if (fs_path.is_relative())
+	{
+		std::filesystem::path relativePath = fs_path;
+		fs_path = basePath / relativePath;
+
+		// include paths are searched in the given order, a missing file is reported relative to the 1st file
+		std::error_code ec;
+		for (size_t i = 0; i < includePaths.size() && !std::filesystem::exists(fs_path, ec); i++)
+		{
+			if (std::filesystem::exists(includePaths.at(i) / relativePath, ec))
+				fs_path = includePaths.at(i) / relativePath;
+		}
+
+		// the cache of a watched build notices when the file gets created in one of the include paths
+		if (cache && !std::filesystem::exists(fs_path, ec))
+		{
+			for (const std::filesystem::path& includePath : includePaths)
+				cache->addMissing(fileTable.getId(includePath / relativePath));
+		}
+	}
+	else
+		fs_path = std::filesystem::absolute(fs_path);
+
+	uint32_t fileId = fileTable.getId(fs_path);
+	resolvedPaths.emplace(path, fileId);
+	return fileId;
+}
+
+std::shared_ptr<const SourceBuffer> SourceFileManager::loadBuffer(uint32_t fileId)
+{
+	if (cache)
+		return cache->getBuffer(fileId);
+
+	std::shared_ptr<SourceBuffer> buffer = std::make_shared<SourceBuffer>();
+
+	if (precompiled)
+		buffer->loadPrecompiled(fileTable.getPath(fileId));
+	else
+		buffer->load(fileTable.getPath(fileId), false);
+
+	return buffer;
+}
+
+void SourceFileManager::prefetchIncludes(const SourceBuffer& buffer)
+{
+	// quick scan for include directives, defines and conditionals are ignored
+	// a file that is prefetched but not included only costs a read
+	for (const std::string& line : buffer.lines)
+	{
+		size_t begin = line.find_first_not_of(" \t");
+		if (begin == std::string::npos || (line.compare(begin, 4, ".inc") != 0 && line.compare(begin, 4, ".INC") != 0))
+			continue;
+
+		begin += 4;
+		if (begin >= line.size() || (line.at(begin) != ' ' && line.at(begin) != '\t'))
+			continue;
+
+		std::string path = line.substr(begin, find_first_of_outside_str(line.substr(begin), ";"));
+		path.erase(0, path.find_first_not_of(" \t"));
+		path.erase(path.find_last_not_of(" \t\r") + 1);
+		removeQuotes(path);
+
+		if (path.empty())
+			continue;
+
+		uint32_t fileId = resolvePath(path);
+		if (!includedFiles.count(fileId))
+			prefetcher.prefetch(fileId);
+	}
 }
\ No newline at end of file
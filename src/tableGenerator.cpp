@@ -0,0 +1,150 @@
+#include "tableGenerator.h"
+#include "converter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+
+// tables smaller than this are not worth spawning threads for
+const uint32_t minEntriesPerThread = 1024;
+
+TABLE_FUNC toTableFunction(std::string str, std::function<void(std::string)> errorFunc)
+{
+	if (str == "sin" || str == "SIN")
+		return TABLE_FUNC::SIN;
+
+	if (str == "cos" || str == "COS")
+		return TABLE_FUNC::COS;
+
+	if (str == "tan" || str == "TAN")
+		return TABLE_FUNC::TAN;
+
+	if (str == "sqrt" || str == "SQRT")
+		return TABLE_FUNC::SQRT;
+
+	if (str == "recip" || str == "RECIP")
+		return TABLE_FUNC::RECIP;
+
+	if (str == "exp2" || str == "EXP2")
+		return TABLE_FUNC::EXP2;
+
+	if (str == "log2" || str == "LOG2")
+		return TABLE_FUNC::LOG2;
+
+	if (str == "poly" || str == "POLY")
+		return TABLE_FUNC::POLY;
+
+	if (errorFunc)
+		errorFunc("unknown table function '" + str + "'.");
+	else
+		throw std::invalid_argument{ "invalid argument" };
+
+	return TABLE_FUNC::SIN;
+}
+
+static double evaluate(TABLE_FUNC func, uint32_t i, uint32_t n, std::vector<double>& coefficients)
+{
+	const double pi = 3.14159265358979323846;
+	// periodic functions cover one period, all others the interval [0, 1)
+	double x = static_cast<double>(i) / n;
+
+	switch (func)
+	{
+	case TABLE_FUNC::SIN:	return std::sin(2.0 * pi * x);
+	case TABLE_FUNC::COS:	return std::cos(2.0 * pi * x);
+	case TABLE_FUNC::TAN:	return std::tan(2.0 * pi * x);
+	case TABLE_FUNC::SQRT:	return std::sqrt(x);
+	case TABLE_FUNC::RECIP:	return 1.0 / (1.0 + x);		// [1, 2), seed for newton iterations
+	case TABLE_FUNC::EXP2:	return std::exp2(x);
+	case TABLE_FUNC::LOG2:	return std::log2(1.0 + x);
+	case TABLE_FUNC::POLY:
+	{
+		// horner scheme, coefficients are given in ascending order
+		double y = 0.0;
+		for (size_t k = coefficients.size(); k > 0; k--)
+			y = y * x + coefficients.at(k - 1);
+		return y;
+	}
+	}
+
+	return 0.0;
+}
+
+std::vector<uint32_t> generateTable(TABLE_FUNC func, uint32_t n, double scale, bool fixed, std::vector<double> coefficients, std::function<void(std::string)> errorFunc)
+{
+	std::vector<uint32_t> table(n, 0);
+	std::atomic<bool> overflow{ false };
+
+	auto generate = [&](uint32_t first, uint32_t last)
+	{
+		for (uint32_t i = first; i < last; i++)
+		{
+			double y = scale * evaluate(func, i, n, coefficients);
+
+			if (!fixed)
+				table.at(i) = floatToWord(static_cast<float>(y));
+
+			else if (std::isfinite(y) && y >= std::numeric_limits<int32_t>::min() && y <= std::numeric_limits<int32_t>::max())
+				table.at(i) = static_cast<uint32_t>(static_cast<int32_t>(std::lround(y)));
+
+			else
+				overflow = true;
+		}
+	};
+
+	// every entry is independent, so the table is split into chunks which are generated in parallel
+	unsigned int threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), n / minEntriesPerThread));
+	std::vector<std::thread> threads;
+	uint32_t chunkSize = n / threadCount;
+
+	for (unsigned int t = 1; t < threadCount; t++)
+		threads.emplace_back(generate, t * chunkSize, t == threadCount - 1 ? n : (t + 1) * chunkSize);
+
+	generate(0, threadCount == 1 ? n : chunkSize);
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	if (overflow)
+	{
+		if (errorFunc)
+			errorFunc("table entries cannot be represented as 32 bit fixed point numbers.");
+		else
+			throw std::out_of_range{ "out of range" };
+	}
+
+	return table;
+}
+
+std::vector<uint32_t> generateCrcTable(uint32_t poly, unsigned int width, bool reflected)
+{
+	std::vector<uint32_t> table(256, 0);
+	uint32_t mask = width >= 32 ? 0xFFFFFFFF : (1u << width) - 1;
+	uint32_t topBit = 1u << (width - 1);
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc;
+
+		// reflected tables shift to the right and expect the reversed polynomial
+		if (reflected)
+		{
+			crc = i;
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+		}
+		else
+		{
+			crc = i << (width - 8);
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc & topBit) ? (crc << 1) ^ poly : crc << 1;
+		}
+
+		table.at(i) = crc & mask;
+	}
+
+	return table;
+}
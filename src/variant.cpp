@@ -0,0 +1,181 @@
+#include "variant.h"
+#include "compiler.h"
+#include "sourceCache.h"
+#include "parser.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <cctype>
+
+// extensions the writers append to a destination which does not end with them already
+const char* const outputExtensions[] = { ".hex", ".mif", ".coe", ".mem", ".rle", ".dlt", ".map", ".lines", ".lines.txt" };
+
+static std::string normalizePath(std::string path)
+{
+	if (path == "-")
+		return path;
+
+	std::string normalized = std::filesystem::absolute(path).lexically_normal().string();
+
+#ifdef _WIN32
+	// file names are not case sensitive
+	for (char& c : normalized)
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+#endif
+
+	return normalized;
+}
+
+// true if the writers of both destinations could write to the same file, e.g. for out and out.hex
+// the formats are not known here, so every output extension counts
+static bool isSameDestination(const std::string& a, const std::string& b)
+{
+	if (a == b)
+		return true;
+
+	const std::string& longer = a.size() > b.size() ? a : b;
+	const std::string& shorter = a.size() > b.size() ? b : a;
+
+	if (longer.compare(0, shorter.size(), shorter) != 0)
+		return false;
+
+	return std::find(std::begin(outputExtensions), std::end(outputExtensions), longer.substr(shorter.size())) != std::end(outputExtensions);
+}
+
+bool parseDefine(std::string define, std::pair<std::string, std::string>& identifierValue)
+{
+	// value defaults to 1
+	size_t pos = define.find('=');
+	identifierValue.first = define.substr(0, pos);
+	identifierValue.second = pos == std::string::npos ? "1" : define.substr(pos + 1);
+
+	return !identifierValue.first.empty();
+}
+
+bool readVariants(std::string path, std::vector<Variant>& variants)
+{
+	std::ifstream file{ path };
+	std::string line;
+	unsigned int lineNumber = 0;
+
+	if (!file.is_open())
+	{
+		std::cout << "Fatal: cannot open matrix file '" << path << "'!" << std::endl;
+		return false;
+	}
+
+	// one variant per line: destination path followed by its defines, separated by whitespaces
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, find_first_of_outside_str(line, ";"));	// cut comment
+
+		std::istringstream stream{ line };
+		std::string word;
+		Variant variant;
+
+		if (!(stream >> variant.dstPath))
+			continue;
+
+		while (stream >> word)
+		{
+			std::pair<std::string, std::string> define;
+
+			if (!parseDefine(word, define))
+			{
+				std::cout << path << ": line: " << lineNumber << ": error: invalid define '" << word << "'." << std::endl;
+				return false;
+			}
+
+			variant.defines.push_back(define);
+		}
+
+		variants.push_back(variant);
+	}
+
+	if (variants.empty())
+	{
+		std::cout << "Fatal: matrix file '" << path << "' contains no variants!" << std::endl;
+		return false;
+	}
+
+	// variants are exported in parallel, two of them must not race on the same temporary file and rename
+	std::vector<std::string> destinations;
+
+	for (Variant& variant : variants)
+	{
+		std::string destination = normalizePath(variant.dstPath);
+
+		for (size_t i = 0; i < destinations.size(); i++)
+		{
+			if (isSameDestination(destinations.at(i), destination))
+			{
+				std::cout << "Fatal: variants '" << variants.at(i).dstPath << "' and '" << variant.dstPath << "' write to the same destination!" << std::endl;
+				return false;
+			}
+		}
+
+		destinations.push_back(destination);
+	}
+
+	return true;
+}
+
+bool compileVariants(std::string srcPath, std::vector<std::pair<std::string, std::string>>& commonDefines,
+	std::vector<Variant>& variants, bool precompiled, bool pipelined, bool parallel, unsigned int encodeThreads, const std::vector<std::string>& includePaths, std::function<bool(ObjectCode&, std::string, std::ostream&)> exportFunc)
+{
+	// every file is read and lexed once, variants only differ in defines and conditionals
+	SourceCache cache;
+	cache.setPrecompiled(precompiled);
+	std::vector<std::ostringstream> logs(variants.size());
+	std::vector<char> results(variants.size(), false);
+	std::atomic<size_t> next{ 0 };
+
+	auto worker = [&]()
+	{
+		Compiler compiler;
+		compiler.setSourceCache(&cache);
+		compiler.setIncludePaths(includePaths);
+		compiler.setPipelined(pipelined);
+		compiler.setParallel(parallel, encodeThreads);
+
+		for (size_t i = next++; i < variants.size(); i = next++)
+		{
+			compiler.clearDefines();
+			for (std::pair<std::string, std::string>& define : commonDefines)
+				compiler.addDefine(define.first, define.second);
+			for (std::pair<std::string, std::string>& define : variants.at(i).defines)
+				compiler.addDefine(define.first, define.second);
+
+			compiler.setLog(logs.at(i));
+			results.at(i) = compiler.compileSource(srcPath) && exportFunc(compiler.objectCode, variants.at(i).dstPath, logs.at(i));
+		}
+	};
+
+	unsigned int threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), static_cast<unsigned int>(variants.size())));
+	std::vector<std::thread> threads;
+
+	for (unsigned int t = 1; t < threadCount; t++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	bool success = true;
+
+	for (size_t i = 0; i < variants.size(); i++)
+	{
+		std::cout << "Variant '" << variants.at(i).dstPath << "':" << std::endl;
+		std::cout << logs.at(i).str();
+		success = success && results.at(i);
+	}
+
+	return success;
+}
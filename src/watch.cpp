@@ -0,0 +1,66 @@
+#include "watch.h"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <csignal>
+#include <string>
+
+// interval between two checks for changed source files
+const std::chrono::milliseconds pollInterval{ 50 };
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void onInterrupt(int)
+{
+	interrupted = 1;
+}
+
+bool watch(SourceCache& cache, std::function<bool()> build)
+{
+	interrupted = 0;
+	void (*previousHandler)(int) = std::signal(SIGINT, onInterrupt);
+
+	// a line "q" on standard input stops watching as well, the end of input is ignored for runs without a terminal
+	// the reader blocks on the input and is left behind on exit
+	std::shared_ptr<std::atomic<bool>> quit = std::make_shared<std::atomic<bool>>(false);
+	std::thread([quit]()
+	{
+		std::string command;
+
+		while (std::getline(std::cin, command))
+		{
+			if (command == "q" || command == "Q")
+			{
+				*quit = true;
+				return;
+			}
+		}
+	}).detach();
+
+	bool success = false;
+
+	// the cache keeps the lexed files between builds, a rebuild only reads and lexes the changed files
+	while (!interrupted && !*quit)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		success = build();
+		std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Build " << (success ? "succeeded" : "failed") << " after " << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << " ms, watching for changes, enter q to stop..." << std::endl;
+
+		bool changed = false;
+
+		while (!changed && !interrupted && !*quit)
+		{
+			std::this_thread::sleep_for(pollInterval);
+			changed = cache.refresh();
+		}
+	}
+
+	std::signal(SIGINT, previousHandler);
+	std::cout << "Stopped watching." << std::endl;
+	return success;
+}
@@ -0,0 +1,10 @@
+; more than one chunk of deferred instructions, so -parallel -threads splits the encoding
+.org [0x1000]
+start:
+.rept 300, i
+	add r1, (\i * 3), r2
+	jne target_\i
+target_\i:
+	ldm r4, [r2+\i]
+.endr
+	jmp start
@@ -0,0 +1,12 @@
+; errors in the first and the last chunk of deferred instructions, they have to be reported in source order
+.org [0x1000]
+start:
+	add r1, r99
+.rept 700, i
+	add r1, (\i * 3), r2
+.endr
+	ldm r4, [nowhere]
+.rept 700, i
+	sub r1, \i
+.endr
+	jmp missing
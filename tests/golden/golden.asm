@@ -0,0 +1,60 @@
+; golden sample, every build mode has to assemble it to golden.hex
+.inc "golden.inc"
+.org [0x1000]
+start:
+	scaled r1, COUNT
+	scaled r2, 7
+	call copy
+	call select
+	jmp start
+
+; macro with a local label and a conditional body
+.macro move src, dst, n
+.if \n > 1
+	inr r6, \n
+loop_\@:
+	ldm r5, [\src]
+	stm r5, [\dst]
+	dec r6
+	jne loop_\@
+.else
+	ldm r5, [\src]
+	stm r5, [\dst]
+.endif
+.endm
+
+copy:
+	move r1, r2, 1
+	move r3, r4, COUNT
+	ret
+
+select:
+.rept COUNT, i
+.if \i == 2
+	add r1, (\i << 4)
+.elif \i > 2
+	sub r1, \i
+.else
+	inc r1
+.endif
+.endr
+.irp reg, r1, r2, r3
+	push \reg
+.ifdef SCALE
+	add \reg, SCALE
+.endif
+	pop \reg
+.endr
+	ret
+
+values:
+.rept 4, k
+.dw (\k * \k + 1)
+.endr
+.dw 1, 2, "golden", 'g', 2.5
+sine:
+.table sin, 16, 32767, fixed
+crc:
+.crctable 0xEDB88320, 32, reflected
+.checksum crc32, start, end
+end:
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+# assembles golden.asm in every build mode and compares the images with golden.hex
+# data words of golden.hex are checked against values computed here, so golden.hex is not only trusted because the assembler wrote it
+# encode.asm and encode_errors.asm are encoded on several threads and compared with the sequential build
+# usage: run_golden.py <assembler> [--update]
+
+import math
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+here = os.path.dirname(os.path.abspath(__file__))
+sources = ["golden.asm", "golden.inc", "encode.asm", "encode_errors.asm"]
+expected = os.path.join(here, "golden.hex")
+
+# -pch runs twice, the first run stores the precompiled files and the second one loads them
+modes = [
+	("plain", []),
+	("parallel", ["-parallel"]),
+	("pipeline", ["-pipeline"]),
+	("pipeline parallel", ["-pipeline", "-parallel"]),
+	("pch store", ["-pch"]),
+	("pch load", ["-pch"]),
+]
+
+# more threads than cores, so the chunks are split even on a single core
+threadModes = [
+	("parallel 4 threads", ["-parallel", "-threads", "4"]),
+	("pipeline parallel 3 threads", ["-pipeline", "-parallel", "-threads", "3"]),
+]
+
+# words of golden.hex which are computed here instead of by the assembler, as offsets from .org [0x1000]
+valuesOffset = 0x27
+sineOffset = 0x36
+crcOffset = 0x46
+checksumOffset = 0x146
+
+
+def checkReferences(image):
+	words = list(struct.unpack("<" + str(len(image) // 4) + "I", image))
+	errors = []
+
+	values = [1, 2, 5, 10, 1, 2] + [ord(c) for c in "golden"] + [0, ord("g"), struct.unpack("<I", struct.pack("<f", 2.5))[0]]
+	if words[valuesOffset:valuesOffset + len(values)] != values:
+		errors.append(".dw values")
+
+	sine = [round(math.sin(2 * math.pi * i / 16) * 32767) & 0xFFFFFFFF for i in range(16)]
+	if words[sineOffset:sineOffset + 16] != sine:
+		errors.append(".table sin")
+
+	crcTable = []
+	for i in range(256):
+		crc = i
+		for bit in range(8):
+			crc = (crc >> 1) ^ 0xEDB88320 if crc & 1 else crc >> 1
+		crcTable.append(crc)
+	if words[crcOffset:crcOffset + 256] != crcTable:
+		errors.append(".crctable")
+
+	# the checksum covers start to end with its own word as zero
+	covered = words[:checksumOffset + 1]
+	covered[checksumOffset] = 0
+	if words[checksumOffset] != zlib.crc32(struct.pack("<" + str(len(covered)) + "I", *covered)):
+		errors.append(".checksum crc32")
+
+	return errors
+
+
+def assemble(assembler, workDir, options, source="golden.asm"):
+	output = os.path.join(workDir, "out")
+
+	if os.path.exists(output + ".hex"):
+		os.remove(output + ".hex")
+
+	result = subprocess.run([assembler, os.path.join(workDir, source), output, "-raw"] + options, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+
+	if result.returncode != 0 or not os.path.exists(output + ".hex"):
+		return None, result.stdout
+
+	with open(output + ".hex", "rb") as file:
+		return file.read(), result.stdout
+
+
+def main():
+	if len(sys.argv) < 2:
+		print("usage: run_golden.py <assembler> [--update]")
+		return 2
+
+	assembler = os.path.abspath(sys.argv[1])
+	update = "--update" in sys.argv[2:]
+	workDir = tempfile.mkdtemp()
+
+	try:
+		# the precompiled files are written next to the sources, so the sources are copied first
+		for source in sources:
+			shutil.copy(os.path.join(here, source), workDir)
+
+		if update:
+			image, log = assemble(assembler, workDir, [])
+
+			if image is None:
+				print(log)
+				return 1
+
+			errors = checkReferences(image)
+
+			if errors:
+				print("not updated, wrong " + ", ".join(errors))
+				return 1
+
+			with open(expected, "wb") as file:
+				file.write(image)
+
+			print("updated golden.hex")
+			return 0
+
+		with open(expected, "rb") as file:
+			golden = file.read()
+
+		failed = 0
+
+		for error in checkReferences(golden):
+			print("FAILED golden.hex: wrong " + error)
+			failed += 1
+
+		for name, options in modes:
+			image, log = assemble(assembler, workDir, options)
+
+			if image is None:
+				print("FAILED " + name + ": assembler error")
+				print(log)
+				failed += 1
+			elif image != golden:
+				diff = next((i for i in range(min(len(image), len(golden))) if image[i] != golden[i]), min(len(image), len(golden)))
+				print("FAILED " + name + ": differs from golden.hex at byte " + str(diff))
+				failed += 1
+			else:
+				print("ok     " + name)
+
+		sequentialImage, _ = assemble(assembler, workDir, [], "encode.asm")
+		sequentialErrors = assemble(assembler, workDir, [], "encode_errors.asm")[1].replace(workDir, "")
+
+		if sequentialImage is None or "3 error(s)" not in sequentialErrors:
+			print("FAILED sequential encoding of encode.asm or encode_errors.asm")
+			return 1
+
+		for name, options in threadModes:
+			image, log = assemble(assembler, workDir, options, "encode.asm")
+			errors = assemble(assembler, workDir, options, "encode_errors.asm")[1].replace(workDir, "")
+
+			if image is None or image != sequentialImage:
+				print("FAILED " + name + ": image differs from the sequential build")
+				print(log)
+				failed += 1
+			elif errors != sequentialErrors:
+				print("FAILED " + name + ": errors differ from the sequential build")
+				print(errors)
+				failed += 1
+			else:
+				print("ok     " + name)
+
+		return 1 if failed else 0
+	finally:
+		shutil.rmtree(workDir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+	sys.exit(main())